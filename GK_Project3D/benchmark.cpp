@@ -0,0 +1,177 @@
+#include "benchmark.h"
+#include "bvh.h"
+#include "culling.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct RandomBounds
+{
+	std::vector<float> center[3];
+	std::vector<float> extent[3];
+
+	BoundsColumns columns() const
+	{
+		return { center[0].data(), center[1].data(), center[2].data(), extent[0].data(), extent[1].data(), extent[2].data() };
+	}
+};
+
+static RandomBounds makeBounds(unsigned int count, std::mt19937& random)
+{
+	// Objects spread over a 1 km cube, sized like the scene's cubes and spheres
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 2.0f);
+	RandomBounds bounds;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		bounds.center[axis].resize(count);
+		bounds.extent[axis].resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			bounds.center[axis][i] = position(random);
+			bounds.extent[axis][i] = size(random);
+		}
+	}
+	return bounds;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+BenchmarkReport::BenchmarkReport(const std::string& path, bool append)
+{
+	if (append)
+	{
+		// The header is only written into a new or empty file
+		std::ifstream existing(path.c_str(), std::ios::ate);
+		bool empty = !existing.good() || existing.tellg() <= 0;
+		csv.open(path.c_str(), std::ios::app);
+		if (empty)
+			csv << "benchmark,objects,threads,value,unit\n";
+		return;
+	}
+	csv.open(path.c_str());
+	csv << "benchmark,objects,threads,value,unit\n";
+}
+
+void BenchmarkReport::add(const std::string& name, unsigned int objects, unsigned int threads, double value, const std::string& unit)
+{
+	std::cout << std::left << std::setw(28) << name << std::setw(10) << objects << std::setw(4) << threads
+		<< std::right << std::setw(14) << std::fixed << std::setprecision(3) << value << " " << unit << std::endl;
+	csv << name << "," << objects << "," << threads << "," << value << "," << unit << "\n";
+}
+
+static void benchmarkBvh(BenchmarkReport& report, unsigned int count, std::mt19937& random)
+{
+	RandomBounds bounds = makeBounds(count, random);
+	const unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	Bvh bvh;
+
+	// Build
+	auto start = std::chrono::steady_clock::now();
+	bvh.build(bounds.columns(), count, 1);
+	report.add("bvh_build", count, 1, elapsedMs(start), "ms");
+
+	start = std::chrono::steady_clock::now();
+	bvh.build(bounds.columns(), count, threads);
+	report.add("bvh_build", count, threads, elapsedMs(start), "ms");
+
+	// Refit, everything and 1% of objects moved
+	std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+	std::vector<unsigned int> moved;
+	for (unsigned int i = 0; i < count; i += 100)
+	{
+		moved.push_back(i);
+		bounds.center[0][i] += step(random);
+		bounds.center[1][i] += step(random);
+	}
+
+	start = std::chrono::steady_clock::now();
+	bvh.refit(bounds.columns(), moved);
+	report.add("bvh_refit_1_percent", count, 1, elapsedMs(start), "ms");
+
+	start = std::chrono::steady_clock::now();
+	bvh.refit(bounds.columns());
+	report.add("bvh_refit_full", count, 1, elapsedMs(start), "ms");
+
+	// Frustum queries from cameras inside the volume, against the linear SIMD scan
+	const unsigned int frustumQueries = 200;
+	std::uniform_real_distribution<float> position(-400.0f, 400.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	std::vector<Frustum> frustums;
+	for (unsigned int i = 0; i < frustumQueries; i++)
+	{
+		glm::vec3 eye(position(random), position(random), position(random));
+		glm::vec3 front = glm::normalize(glm::vec3(direction(random), direction(random) * 0.3f, direction(random)) + glm::vec3(0.001f));
+		frustums.push_back(Frustum::FromMatrix(projection * glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f))));
+	}
+
+	std::vector<unsigned int> result;
+	size_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (const Frustum& frustum : frustums)
+	{
+		bvh.queryFrustum(frustum, bounds.columns(), result);
+		found += result.size();
+	}
+	report.add("bvh_frustum_query", count, 1, frustumQueries / (elapsedMs(start) / 1000.0), "queries/s");
+
+	std::vector<unsigned int> visible(count);
+	size_t foundLinear = 0;
+	start = std::chrono::steady_clock::now();
+	for (const Frustum& frustum : frustums)
+		foundLinear += cullBounds(frustum, bounds.columns(), count, visible.data());
+	report.add("linear_frustum_cull", count, 1, frustumQueries / (elapsedMs(start) / 1000.0), "queries/s");
+	if (found != foundLinear)
+		std::cout << "ERROR::BENCHMARK::FRUSTUM_RESULTS_DIFFER " << found << " " << foundLinear << std::endl;
+
+	// Ray and sphere queries
+	const unsigned int rayQueries = 100000;
+	unsigned int hits = 0;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < rayQueries; i++)
+	{
+		glm::vec3 origin(position(random), position(random), position(random));
+		glm::vec3 dir = glm::normalize(glm::vec3(direction(random), direction(random), direction(random)) + glm::vec3(0.001f));
+		if (bvh.queryRay(origin, dir, 200.0f, bounds.columns()).primitive != Bvh::NO_PRIMITIVE)
+			hits++;
+	}
+	report.add("bvh_ray_query", count, 1, rayQueries / (elapsedMs(start) / 1000.0), "queries/s");
+
+	const unsigned int sphereQueries = 100000;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < sphereQueries; i++)
+	{
+		bvh.querySphere(glm::vec3(position(random), position(random), position(random)), 10.0f, bounds.columns(), result);
+		found += result.size();
+	}
+	report.add("bvh_sphere_query", count, 1, sphereQueries / (elapsedMs(start) / 1000.0), "queries/s");
+}
+
+int runBenchmarks(const std::string& csvPath)
+{
+	BenchmarkReport report(csvPath);
+	if (!report.good())
+	{
+		std::cout << "Benchmark results failed to open at path: " << csvPath << std::endl;
+		return -1;
+	}
+
+	std::mt19937 random(1234);
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (unsigned int count : counts)
+		benchmarkBvh(report, count, random);
+
+	std::cout << "Benchmark results written to " << csvPath << std::endl;
+	return 0;
+}
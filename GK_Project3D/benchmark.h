@@ -0,0 +1,25 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <fstream>
+#include <string>
+
+// CPU benchmarks of the scene structures, run with "GK_Project3D --benchmark".
+// Needs no window or GL context. Results are printed and written to csvPath.
+int runBenchmarks(const std::string& csvPath);
+
+// Rows of "benchmark,objects,threads,value,unit", each also printed. Appending keeps the rows
+// already in the file, so the render statistics of a windowed run can join the benchmarks.
+class BenchmarkReport
+{
+public:
+	explicit BenchmarkReport(const std::string& path, bool append = false);
+
+	void add(const std::string& name, unsigned int objects, unsigned int threads, double value, const std::string& unit);
+	bool good() const { return csv.good(); }
+
+private:
+	std::ofstream csv;
+};
+
+#endif
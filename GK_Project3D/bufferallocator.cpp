@@ -0,0 +1,216 @@
+#include "bufferallocator.h"
+
+#include <glfw3.h>
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+#include "renderstats.h"
+
+// Not part of the GL 3.3 loader, fetched at run time
+typedef void (APIENTRYP PFN_BUFFER_STORAGE)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static PFN_BUFFER_STORAGE bufferStorage = nullptr;
+
+bool loadBufferStorage()
+{
+	bufferStorage = nullptr;
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool core = major > 4 || (major == 4 && minor >= 4);
+	if (!core && !glfwExtensionSupported("GL_ARB_buffer_storage"))
+		return false;
+
+	bufferStorage = (PFN_BUFFER_STORAGE)glfwGetProcAddress("glBufferStorage");
+	return bufferStorage != nullptr;
+}
+
+bool bufferStorageSupported()
+{
+	return bufferStorage != nullptr;
+}
+
+void createBufferStorage(GLenum target, size_t size, const void* data, GLbitfield flags)
+{
+	if (bufferStorage != nullptr)
+		bufferStorage(target, (GLsizeiptr)size, data, flags);
+	else
+		glBufferData(target, (GLsizeiptr)size, data, GL_DYNAMIC_DRAW);
+	if (data != nullptr)
+		renderStats.countBufferUpload(size);
+}
+
+
+// STATISTICS
+
+float BufferAllocatorStats::fragmentation() const
+{
+	size_t freeBytes = capacity - used;
+	return freeBytes > 0 ? 1.0f - (float)largestFreeBlock / freeBytes : 0.0f;
+}
+
+BufferAllocatorStats BufferAllocator::stats() const
+{
+	BufferAllocatorStats result;
+	result.capacity = capacity;
+	result.used = used;
+	result.allocations = (unsigned int)(records.size() - freeRecords.size());
+	result.freeBlocks = (unsigned int)freeRanges.size();
+	for (const auto& range : freeRanges)
+		result.largestFreeBlock = std::max(result.largestFreeBlock, range.second);
+	return result;
+}
+
+
+// ALLOCATION
+
+void BufferAllocator::create(size_t capacity, size_t alignment)
+{
+	this->alignment = std::max<size_t>(1, alignment);
+	this->capacity = capacity / this->alignment * this->alignment;
+	used = 0;
+	records.clear();
+	freeRecords.clear();
+	freeRanges.clear();
+	freeRanges[0] = this->capacity;
+
+	// Immutable storage cannot be resized, a new buffer replaces the old one
+	if (bufferName != 0)
+		glDeleteBuffers(1, &bufferName);
+	glGenBuffers(1, &bufferName);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferName);
+	createBufferStorage(GL_COPY_WRITE_BUFFER, this->capacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+BufferAllocation BufferAllocator::allocate(size_t size)
+{
+	size = std::max<size_t>(1, (size + alignment - 1) / alignment) * alignment;
+
+	// Best fit keeps the large blocks for large requests
+	auto best = freeRanges.end();
+	for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range)
+	{
+		if (range->second >= size && (best == freeRanges.end() || range->second < best->second))
+			best = range;
+	}
+	if (best == freeRanges.end())
+	{
+		std::cout << "ERROR::BUFFER_ALLOCATOR::OUT_OF_MEMORY " << size << " bytes" << std::endl;
+		return NO_ALLOCATION;
+	}
+
+	size_t offset = best->first;
+	size_t remaining = best->second - size;
+	freeRanges.erase(best);
+	if (remaining > 0)
+		freeRanges[offset + size] = remaining;
+
+	BufferAllocation allocation;
+	if (!freeRecords.empty())
+	{
+		allocation = freeRecords.back();
+		freeRecords.pop_back();
+	}
+	else
+	{
+		allocation = (BufferAllocation)records.size();
+		records.push_back(Record());
+	}
+	records[allocation] = { offset, size, true };
+	used += size;
+	return allocation;
+}
+
+void BufferAllocator::free(BufferAllocation allocation)
+{
+	if (allocation == NO_ALLOCATION || !records[allocation].live)
+		return;
+
+	Record& record = records[allocation];
+	record.live = false;
+	used -= record.size;
+	freeRecords.push_back(allocation);
+
+	// Merge with the free neighbours on both sides
+	size_t offset = record.offset;
+	size_t size = record.size;
+	auto next = freeRanges.lower_bound(offset);
+	if (next != freeRanges.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = freeRanges.erase(next);
+	}
+	if (next != freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	freeRanges[offset] = size;
+}
+
+void BufferAllocator::write(BufferAllocation allocation, size_t offset, size_t size, const void* data)
+{
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferName);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, records[allocation].offset + offset, size, data);
+	renderStats.countBufferUpload(size);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void BufferAllocator::defragment()
+{
+	std::vector<BufferAllocation> live;
+	for (BufferAllocation allocation = 0; allocation < records.size(); allocation++)
+	{
+		if (records[allocation].live)
+			live.push_back(allocation);
+	}
+	std::sort(live.begin(), live.end(), [&](BufferAllocation a, BufferAllocation b) { return records[a].offset < records[b].offset; });
+
+	// Ranges only move towards the start. One that would overlap its old place goes through a scratch buffer.
+	size_t cursor = 0;
+	for (BufferAllocation allocation : live)
+	{
+		Record& record = records[allocation];
+		if (record.offset != cursor)
+		{
+			if (cursor + record.size <= record.offset)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, bufferName);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, bufferName);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, record.offset, cursor, record.size);
+			}
+			else
+			{
+				if (scratchSize < record.size)
+				{
+					if (scratchBuffer == 0)
+						glGenBuffers(1, &scratchBuffer);
+					scratchSize = record.size;
+					glBindBuffer(GL_COPY_WRITE_BUFFER, scratchBuffer);
+					glBufferData(GL_COPY_WRITE_BUFFER, scratchSize, NULL, GL_STREAM_COPY);
+				}
+				glBindBuffer(GL_COPY_READ_BUFFER, bufferName);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, scratchBuffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, record.offset, 0, record.size);
+				glBindBuffer(GL_COPY_READ_BUFFER, scratchBuffer);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, bufferName);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, cursor, record.size);
+			}
+			record.offset = cursor;
+		}
+		cursor += record.size;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	freeRanges.clear();
+	if (cursor < capacity)
+		freeRanges[cursor] = capacity - cursor;
+	defragmentations++;
+}
@@ -0,0 +1,89 @@
+#ifndef BUFFERALLOCATOR_H
+#define BUFFERALLOCATOR_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Buffer storage flags, not part of the GL 3.3 headers
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+// Loads glBufferStorage through GLFW (GL 4.4 or ARB_buffer_storage)
+bool loadBufferStorage();
+bool bufferStorageSupported();
+// Immutable storage for the buffer bound to target, or glBufferData when it is not supported
+void createBufferStorage(GLenum target, size_t size, const void* data, GLbitfield flags);
+
+typedef unsigned int BufferAllocation;
+const BufferAllocation NO_ALLOCATION = 0xFFFFFFFF;
+
+struct BufferAllocatorStats
+{
+	size_t capacity = 0;
+	size_t used = 0;
+	size_t largestFreeBlock = 0;
+	unsigned int allocations = 0;
+	unsigned int freeBlocks = 0;
+
+	float utilization() const { return capacity > 0 ? (float)used / capacity : 0.0f; }
+	// 0 when all free space is one block, close to 1 when it is split in many small ones
+	float fragmentation() const;
+};
+
+// Ranges of one large GL buffer of fixed size, handed out from a best fit free list.
+// Freed neighbours merge back together and defragment() packs every live range to the
+// start of the buffer on the GPU. Offsets can change there, so users read offset()
+// again whenever generation() changes.
+class BufferAllocator
+{
+public:
+	BufferAllocator() {}
+	BufferAllocator(const BufferAllocator&) = delete;
+	BufferAllocator& operator=(const BufferAllocator&) = delete;
+
+	// Every offset and size is a multiple of alignment (e.g. the vertex stride)
+	void create(size_t capacity, size_t alignment);
+
+	BufferAllocation allocate(size_t size);
+	void free(BufferAllocation allocation);
+	void write(BufferAllocation allocation, size_t offset, size_t size, const void* data);
+	// Moves every live range to the start of the buffer, leaving one free block at the end
+	void defragment();
+
+	unsigned int buffer() const { return bufferName; }
+	size_t offset(BufferAllocation allocation) const { return records[allocation].offset; }
+	size_t size(BufferAllocation allocation) const { return records[allocation].size; }
+	unsigned int generation() const { return defragmentations; }
+	BufferAllocatorStats stats() const;
+
+private:
+	struct Record
+	{
+		size_t offset;
+		size_t size;
+		bool live;
+	};
+
+	unsigned int bufferName = 0;
+	unsigned int scratchBuffer = 0;
+	size_t scratchSize = 0;
+	size_t capacity = 0;
+	size_t alignment = 1;
+	size_t used = 0;
+	unsigned int defragmentations = 0;
+	std::map<size_t, size_t> freeRanges;    // offset -> size
+	std::vector<Record> records;
+	std::vector<BufferAllocation> freeRecords;
+};
+
+#endif
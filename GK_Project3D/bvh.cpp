@@ -0,0 +1,458 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <thread>
+
+const unsigned int NO_NODE = 0xFFFFFFFF;
+const unsigned int BIN_COUNT = 16;
+const unsigned int MAX_LEAF_SIZE = 4;
+// Nodes bigger than this are built on another thread while the upper levels are split
+const unsigned int PARALLEL_BUILD_THRESHOLD = 4096;
+
+struct Bvh::BuildContext
+{
+	const BoundsColumns& bounds;
+	std::atomic<unsigned int> nodesUsed;
+	unsigned int parallelDepth;
+
+	BuildContext(const BoundsColumns& bounds) : bounds(bounds), nodesUsed(0), parallelDepth(0) {}
+};
+
+static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static glm::vec3 primitiveMin(const BoundsColumns& bounds, unsigned int i)
+{
+	return glm::vec3(bounds.centerX[i] - bounds.extentX[i], bounds.centerY[i] - bounds.extentY[i], bounds.centerZ[i] - bounds.extentZ[i]);
+}
+
+static glm::vec3 primitiveMax(const BoundsColumns& bounds, unsigned int i)
+{
+	return glm::vec3(bounds.centerX[i] + bounds.extentX[i], bounds.centerY[i] + bounds.extentY[i], bounds.centerZ[i] + bounds.extentZ[i]);
+}
+
+static float primitiveCenter(const BoundsColumns& bounds, unsigned int i, int axis)
+{
+	return axis == 0 ? bounds.centerX[i] : (axis == 1 ? bounds.centerY[i] : bounds.centerZ[i]);
+}
+
+
+// BUILD
+
+void Bvh::build(const BoundsColumns& bounds, unsigned int count, unsigned int threadCount)
+{
+	nodes.clear();
+	parents.clear();
+	primitives.resize(count);
+	leafOf.assign(count, NO_NODE);
+	if (count == 0)
+		return;
+
+	for (unsigned int i = 0; i < count; i++)
+		primitives[i] = i;
+
+	// A binary tree with one or more primitives per leaf never needs more than 2n - 1 nodes
+	nodes.resize(2 * count - 1);
+	parents.resize(2 * count - 1);
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	BuildContext context(bounds);
+	while ((1u << context.parallelDepth) < threadCount)
+		context.parallelDepth++;
+
+	context.nodesUsed = 1;
+	nodes[0].first = 0;
+	nodes[0].count = count;
+	parents[0] = NO_NODE;
+	buildNode(context, 0, 0);
+
+	nodes.resize(context.nodesUsed);
+	parents.resize(context.nodesUsed);
+	for (unsigned int n = 0; n < nodes.size(); n++)
+	{
+		if (!nodes[n].isLeaf())
+			continue;
+		for (unsigned int i = 0; i < nodes[n].count; i++)
+			leafOf[primitives[nodes[n].first + i]] = n;
+	}
+}
+
+void Bvh::buildNode(BuildContext& context, unsigned int nodeIndex, unsigned int depth)
+{
+	const BoundsColumns& bounds = context.bounds;
+	BvhNode& node = nodes[nodeIndex];
+	const unsigned int first = node.first;
+	const unsigned int count = node.count;
+
+	// Node bounds and the bounds of primitive centers
+	glm::vec3 centerMin(std::numeric_limits<float>::max());
+	glm::vec3 centerMax(-std::numeric_limits<float>::max());
+	fitLeaf(node, bounds);
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		glm::vec3 center(bounds.centerX[primitives[i]], bounds.centerY[primitives[i]], bounds.centerZ[primitives[i]]);
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+	if (count <= MAX_LEAF_SIZE)
+		return;
+
+	glm::vec3 centerSize = centerMax - centerMin;
+	int axis = 0;
+	if (centerSize.y > centerSize[axis])
+		axis = 1;
+	if (centerSize.z > centerSize[axis])
+		axis = 2;
+
+	unsigned int leftCount = 0;
+	if (centerSize[axis] > 0.0f)
+	{
+		// Bin primitives by center and pick the split with the lowest surface area cost
+		unsigned int binCount[BIN_COUNT] = {};
+		glm::vec3 binMin[BIN_COUNT];
+		glm::vec3 binMax[BIN_COUNT];
+		for (unsigned int b = 0; b < BIN_COUNT; b++)
+		{
+			binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+			binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+		}
+
+		const float scale = BIN_COUNT / centerSize[axis];
+		auto binOf = [&](unsigned int primitive)
+		{
+			unsigned int bin = (unsigned int)((primitiveCenter(bounds, primitive, axis) - centerMin[axis]) * scale);
+			return std::min(bin, BIN_COUNT - 1);
+		};
+
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			unsigned int bin = binOf(primitives[i]);
+			binCount[bin]++;
+			binMin[bin] = glm::min(binMin[bin], primitiveMin(bounds, primitives[i]));
+			binMax[bin] = glm::max(binMax[bin], primitiveMax(bounds, primitives[i]));
+		}
+
+		// Sweep from the right to get the cost of every right side, then from the left
+		float rightArea[BIN_COUNT];
+		unsigned int rightCount[BIN_COUNT];
+		glm::vec3 sweepMin(std::numeric_limits<float>::max());
+		glm::vec3 sweepMax(-std::numeric_limits<float>::max());
+		unsigned int sweepCount = 0;
+		for (unsigned int b = BIN_COUNT - 1; b > 0; b--)
+		{
+			sweepMin = glm::min(sweepMin, binMin[b]);
+			sweepMax = glm::max(sweepMax, binMax[b]);
+			sweepCount += binCount[b];
+			rightArea[b] = surfaceArea(sweepMin, sweepMax);
+			rightCount[b] = sweepCount;
+		}
+
+		float bestCost = std::numeric_limits<float>::max();
+		unsigned int bestSplit = 0;
+		sweepMin = glm::vec3(std::numeric_limits<float>::max());
+		sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+		sweepCount = 0;
+		for (unsigned int b = 1; b < BIN_COUNT; b++)
+		{
+			sweepMin = glm::min(sweepMin, binMin[b - 1]);
+			sweepMax = glm::max(sweepMax, binMax[b - 1]);
+			sweepCount += binCount[b - 1];
+			if (sweepCount == 0 || rightCount[b] == 0)
+				continue;
+			float cost = sweepCount * surfaceArea(sweepMin, sweepMax) + rightCount[b] * rightArea[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		float leafCost = count * surfaceArea(node.boundsMin, node.boundsMax);
+		if (bestSplit == 0 || (bestCost >= leafCost && count <= 4 * MAX_LEAF_SIZE))
+			return;
+
+		unsigned int* middle = std::partition(&primitives[first], &primitives[first] + count,
+			[&](unsigned int primitive) { return binOf(primitive) < bestSplit; });
+		leftCount = (unsigned int)(middle - &primitives[first]);
+	}
+
+	// All centers in one spot (or one bin), split the range in half instead
+	if (leftCount == 0 || leftCount == count)
+	{
+		leftCount = count / 2;
+		std::nth_element(&primitives[first], &primitives[first] + leftCount, &primitives[first] + count,
+			[&](unsigned int a, unsigned int b) { return primitiveCenter(bounds, a, axis) < primitiveCenter(bounds, b, axis); });
+	}
+
+	unsigned int left = context.nodesUsed.fetch_add(2);
+	nodes[left].first = first;
+	nodes[left].count = leftCount;
+	nodes[left + 1].first = first + leftCount;
+	nodes[left + 1].count = count - leftCount;
+	parents[left] = nodeIndex;
+	parents[left + 1] = nodeIndex;
+	node.first = left;
+	node.count = 0;
+
+	if (depth < context.parallelDepth && count >= PARALLEL_BUILD_THRESHOLD)
+	{
+		std::future<void> leftTask = std::async(std::launch::async, [&]() { buildNode(context, left, depth + 1); });
+		buildNode(context, left + 1, depth + 1);
+		leftTask.wait();
+	}
+	else
+	{
+		buildNode(context, left, depth + 1);
+		buildNode(context, left + 1, depth + 1);
+	}
+}
+
+
+// REFIT
+
+void Bvh::fitLeaf(BvhNode& node, const BoundsColumns& bounds) const
+{
+	node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	for (unsigned int i = node.first; i < node.first + node.count; i++)
+	{
+		node.boundsMin = glm::min(node.boundsMin, primitiveMin(bounds, primitives[i]));
+		node.boundsMax = glm::max(node.boundsMax, primitiveMax(bounds, primitives[i]));
+	}
+}
+
+void Bvh::fitInner(unsigned int nodeIndex)
+{
+	BvhNode& node = nodes[nodeIndex];
+	const BvhNode& left = nodes[node.first];
+	const BvhNode& right = nodes[node.first + 1];
+	node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+	node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+}
+
+void Bvh::refit(const BoundsColumns& bounds)
+{
+	// Children are always stored after their parent
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		if (nodes[n].isLeaf())
+			fitLeaf(nodes[n], bounds);
+		else
+			fitInner((unsigned int)n);
+	}
+}
+
+void Bvh::refit(const BoundsColumns& bounds, const std::vector<unsigned int>& moved)
+{
+	for (unsigned int primitive : moved)
+	{
+		if (primitive >= leafOf.size())
+			continue;
+
+		unsigned int nodeIndex = leafOf[primitive];
+		fitLeaf(nodes[nodeIndex], bounds);
+		for (nodeIndex = parents[nodeIndex]; nodeIndex != NO_NODE; nodeIndex = parents[nodeIndex])
+		{
+			glm::vec3 oldMin = nodes[nodeIndex].boundsMin;
+			glm::vec3 oldMax = nodes[nodeIndex].boundsMax;
+			fitInner(nodeIndex);
+			// Nothing above changes once a node keeps its bounds
+			if (oldMin == nodes[nodeIndex].boundsMin && oldMax == nodes[nodeIndex].boundsMax)
+				break;
+		}
+	}
+}
+
+
+// QUERIES
+
+void Bvh::collect(unsigned int nodeIndex, std::vector<unsigned int>& result) const
+{
+	// Every leaf below a node covers one contiguous primitive range, find its ends
+	unsigned int firstLeaf = nodeIndex;
+	while (!nodes[firstLeaf].isLeaf())
+		firstLeaf = nodes[firstLeaf].first;
+	unsigned int lastLeaf = nodeIndex;
+	while (!nodes[lastLeaf].isLeaf())
+		lastLeaf = nodes[lastLeaf].first + 1;
+
+	unsigned int begin = nodes[firstLeaf].first;
+	unsigned int end = nodes[lastLeaf].first + nodes[lastLeaf].count;
+	result.insert(result.end(), primitives.begin() + begin, primitives.begin() + end);
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, const BoundsColumns& bounds, std::vector<unsigned int>& result) const
+{
+	result.clear();
+	if (nodes.empty())
+		return;
+
+	thread_local std::vector<unsigned int> stack;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		unsigned int nodeIndex = stack.back();
+		stack.pop_back();
+		const BvhNode& node = nodes[nodeIndex];
+
+		glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+		glm::vec3 extent = (node.boundsMax - node.boundsMin) * 0.5f;
+		bool inside = true;
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			outside = distance + radius < 0.0f;
+			inside = inside && distance - radius >= 0.0f;
+		}
+		if (outside)
+			continue;
+
+		if (inside)
+		{
+			collect(nodeIndex, result);
+		}
+		else if (node.isLeaf())
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				unsigned int primitive = primitives[i];
+				glm::vec3 primitiveCenter(bounds.centerX[primitive], bounds.centerY[primitive], bounds.centerZ[primitive]);
+				glm::vec3 primitiveExtent(bounds.extentX[primitive], bounds.extentY[primitive], bounds.extentZ[primitive]);
+				if (boundsVisible(frustum, primitiveCenter, primitiveExtent))
+					result.push_back(primitive);
+			}
+		}
+		else
+		{
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+		}
+	}
+}
+
+static float distanceSquared(const glm::vec3& point, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 closest = glm::clamp(point, boundsMin, boundsMax);
+	glm::vec3 offset = point - closest;
+	return glm::dot(offset, offset);
+}
+
+void Bvh::querySphere(const glm::vec3& center, float radius, const BoundsColumns& bounds, std::vector<unsigned int>& result) const
+{
+	result.clear();
+	if (nodes.empty())
+		return;
+
+	const float radiusSquared = radius * radius;
+	thread_local std::vector<unsigned int> stack;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& node = nodes[stack.back()];
+		stack.pop_back();
+		if (distanceSquared(center, node.boundsMin, node.boundsMax) > radiusSquared)
+			continue;
+
+		if (!node.isLeaf())
+		{
+			stack.push_back(node.first + 1);
+			stack.push_back(node.first);
+			continue;
+		}
+		for (unsigned int i = node.first; i < node.first + node.count; i++)
+		{
+			unsigned int primitive = primitives[i];
+			if (distanceSquared(center, primitiveMin(bounds, primitive), primitiveMax(bounds, primitive)) <= radiusSquared)
+				result.push_back(primitive);
+		}
+	}
+}
+
+// Distance along the ray to the box, or a negative value when it is missed
+static float rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	float enter = 0.0f, exit = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// Parallel to the slab the ray is inside it everywhere or nowhere, and 0 * inf would be NaN
+		if (std::isinf(inverseDirection[axis]))
+		{
+			if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+				return -1.0f;
+			continue;
+		}
+		float t0 = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+		enter = std::max(enter, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+	return enter <= exit ? enter : -1.0f;
+}
+
+BvhRayHit Bvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const BoundsColumns& bounds) const
+{
+	BvhRayHit hit = { NO_PRIMITIVE, maxDistance };
+	if (nodes.empty())
+		return hit;
+
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	thread_local std::vector<unsigned int> stack;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& node = nodes[stack.back()];
+		stack.pop_back();
+		if (rayBox(origin, inverseDirection, hit.distance, node.boundsMin, node.boundsMax) < 0.0f)
+			continue;
+
+		if (node.isLeaf())
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				unsigned int primitive = primitives[i];
+				float distance = rayBox(origin, inverseDirection, hit.distance, primitiveMin(bounds, primitive), primitiveMax(bounds, primitive));
+				if (distance >= 0.0f && distance < hit.distance)
+				{
+					hit.primitive = primitive;
+					hit.distance = distance;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so farther subtrees can be skipped by the shrinking hit distance
+		const BvhNode& left = nodes[node.first];
+		const BvhNode& right = nodes[node.first + 1];
+		float leftDistance = rayBox(origin, inverseDirection, hit.distance, left.boundsMin, left.boundsMax);
+		float rightDistance = rayBox(origin, inverseDirection, hit.distance, right.boundsMin, right.boundsMax);
+		if (leftDistance >= 0.0f && rightDistance >= 0.0f)
+		{
+			bool leftFirst = leftDistance <= rightDistance;
+			stack.push_back(leftFirst ? node.first + 1 : node.first);
+			stack.push_back(leftFirst ? node.first : node.first + 1);
+		}
+		else if (leftDistance >= 0.0f)
+		{
+			stack.push_back(node.first);
+		}
+		else if (rightDistance >= 0.0f)
+		{
+			stack.push_back(node.first + 1);
+		}
+	}
+	return hit;
+}
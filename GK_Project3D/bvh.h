@@ -0,0 +1,67 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "camera.h"
+#include "culling.h"
+
+struct BvhNode
+{
+	glm::vec3 boundsMin;
+	unsigned int first;     // first child for inner nodes (the second one follows it), first primitive for leaves
+	glm::vec3 boundsMax;
+	unsigned int count;     // number of primitives, 0 for inner nodes
+
+	bool isLeaf() const { return count > 0; }
+};
+
+struct BvhRayHit
+{
+	unsigned int primitive;
+	float distance;
+};
+
+// Bounding volume hierarchy over world space AABBs (center/extent columns, e.g. the entity store).
+// Built top-down with a binned SAH, the upper levels are split across threads.
+// Moving primitives keep the topology and only refit the bounds on their path to the root.
+class Bvh
+{
+public:
+	static const unsigned int NO_PRIMITIVE = 0xFFFFFFFF;
+
+	// threadCount 0 uses every hardware thread
+	void build(const BoundsColumns& bounds, unsigned int count, unsigned int threadCount = 0);
+
+	// Recomputes every node from the primitive bounds
+	void refit(const BoundsColumns& bounds);
+	// Recomputes only the nodes above the moved primitives
+	void refit(const BoundsColumns& bounds, const std::vector<unsigned int>& moved);
+
+	// Primitives whose bounds are at least partially inside the frustum
+	void queryFrustum(const Frustum& frustum, const BoundsColumns& bounds, std::vector<unsigned int>& result) const;
+	// Primitives whose bounds touch the sphere
+	void querySphere(const glm::vec3& center, float radius, const BoundsColumns& bounds, std::vector<unsigned int>& result) const;
+	// Nearest primitive bounds hit by the ray, primitive is NO_PRIMITIVE when nothing is hit
+	BvhRayHit queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const BoundsColumns& bounds) const;
+
+	unsigned int nodeCount() const { return (unsigned int)nodes.size(); }
+	unsigned int primitiveCount() const { return (unsigned int)primitives.size(); }
+	bool empty() const { return nodes.empty(); }
+
+private:
+	struct BuildContext;
+	void buildNode(BuildContext& context, unsigned int nodeIndex, unsigned int depth);
+	void fitLeaf(BvhNode& node, const BoundsColumns& bounds) const;
+	void fitInner(unsigned int nodeIndex);
+	void collect(unsigned int nodeIndex, std::vector<unsigned int>& result) const;
+
+	std::vector<BvhNode> nodes;
+	std::vector<unsigned int> primitives;   // primitive indices, leaves reference ranges of it
+	std::vector<unsigned int> parents;      // per node
+	std::vector<unsigned int> leafOf;       // per primitive
+};
+
+#endif
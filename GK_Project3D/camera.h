@@ -13,6 +13,34 @@ const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
 
 
+// View frustum as six planes (a, b, c, d) with normals pointing inside.
+// A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum
+{
+    enum { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR };
+    glm::vec4 planes[6];
+
+    // extracts the planes from a combined projection * view matrix (Gribb/Hartmann)
+    static Frustum FromMatrix(const glm::mat4& m)
+    {
+        Frustum frustum;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        frustum.planes[PLANE_LEFT] = row3 + row0;
+        frustum.planes[PLANE_RIGHT] = row3 - row0;
+        frustum.planes[PLANE_BOTTOM] = row3 + row1;
+        frustum.planes[PLANE_TOP] = row3 - row1;
+        frustum.planes[PLANE_NEAR] = row3 + row2;
+        frustum.planes[PLANE_FAR] = row3 - row2;
+        for (int i = 0; i < 6; i++)
+            frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+        return frustum;
+    }
+};
+
+
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
 class Camera
 {
@@ -36,5 +64,11 @@ public:
     {
         return glm::lookAt(Position, Position + Front, Up);
     }
+
+    // returns the world space view frustum for the given projection matrix
+    Frustum GetFrustum(const glm::mat4& projection)
+    {
+        return Frustum::FromMatrix(projection * GetViewMatrix());
+    }
 };
 #endif
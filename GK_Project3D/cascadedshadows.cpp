@@ -0,0 +1,249 @@
+#include "cascadedshadows.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "glstate.h"
+#include "renderstats.h"
+#include "shadowatlas.h"
+
+static_assert(MAX_SHADOW_CASCADES == 4, "splits and texel sizes keep one cascade per vec4 component");
+
+// Casters up to this far behind a slice, towards the light, still shadow it
+const float CASCADE_CASTER_REACH = 50.0f;
+// Slice spheres grow in these steps, so rounding noise does not change their size
+const float CASCADE_RADIUS_STEP = 1.0f / 16.0f;
+const float CASCADE_OFFSET_FACTOR = 2.0f;
+const float CASCADE_OFFSET_UNITS = 4.0f;
+
+void CascadedShadowMaps::create(const MeshPool& pool, BufferAllocator* instanceStorage, unsigned int cascadeCount, unsigned int resolution)
+{
+	this->pool = &pool;
+	this->instanceStorage = instanceStorage;
+	glGenFramebuffers(1, &FBO);
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	frameDataStride = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+	DrawData drawData = DrawData();
+	drawData.model = glm::mat4(1.0f);
+	drawData.instanced = GL_TRUE;
+	glGenBuffers(1, &uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_SHADOW_CASCADES * frameDataStride + sizeof(DrawData), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, MAX_SHADOW_CASCADES * frameDataStride, sizeof(DrawData), &drawData);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	configure(cascadeCount, resolution);
+}
+
+void CascadedShadowMaps::configure(unsigned int cascadeCount, unsigned int resolution)
+{
+	this->cascadeCount = std::min(std::max(cascadeCount, 1u), MAX_SHADOW_CASCADES);
+	this->resolution = resolution;
+
+	if (depthTexture != 0)
+		glDeleteTextures(1, &depthTexture);
+	glGenTextures(1, &depthTexture);
+	glState.bindTexture(CASCADE_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, this->cascadeCount, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::CASCADED_SHADOWS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (unsigned int c = 0; c < this->cascadeCount; c++)
+	{
+		Cascade& cascade = cascades[c];
+		if (cascade.VAO == 0)
+		{
+			cascade.VAO = pool->createVertexArray();
+			cascade.draws.attach(*pool, instanceStorage, cascade.VAO);
+		}
+		cascade.dirty = true;
+	}
+}
+
+void CascadedShadowMaps::fit(unsigned int c, const glm::mat4& inverseViewProjection, float zNear, float zFar,
+	float splitNear, float splitFar, const glm::mat4& lightView)
+{
+	// Corners of the slice, on the edges of the camera frustum where they reach the split depths
+	glm::vec3 corners[8];
+	glm::vec3 center = glm::vec3(0.0f);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		float x = (i & 1) ? 1.0f : -1.0f, y = (i & 2) ? 1.0f : -1.0f;
+		glm::vec4 nearCorner = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		glm::vec4 farCorner = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		glm::vec3 from = glm::vec3(nearCorner) / nearCorner.w, to = glm::vec3(farCorner) / farCorner.w;
+		corners[i] = glm::mix(from, to, (splitNear - zNear) / (zFar - zNear));
+		corners[i + 4] = glm::mix(from, to, (splitFar - zNear) / (zFar - zNear));
+		center += corners[i] + corners[i + 4];
+	}
+	center /= 8.0f;
+	float radius = 0.0f;
+	for (const glm::vec3& corner : corners)
+		radius = std::max(radius, glm::length(corner - center));
+	radius = std::ceil(radius / CASCADE_RADIUS_STEP) * CASCADE_RADIUS_STEP;
+
+	// The light view keeps its orientation, the box around the sphere moves in whole texels
+	float texel = 2.0f * radius / resolution;
+	glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+	lightCenter = glm::floor(lightCenter / texel) * texel;
+	glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+		-lightCenter.z - radius - CASCADE_CASTER_REACH, -lightCenter.z + radius);
+
+	Cascade& cascade = cascades[c];
+	if (projection != cascade.projection || lightView != cascade.lightView)
+		cascade.dirty = true;
+	cascade.projection = projection;
+	cascade.lightView = lightView;
+	cascade.center = center;
+	cascade.stats.splitFar = splitFar;
+	cascade.stats.worldTexelSize = texel;
+}
+
+void CascadedShadowMaps::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightDirection,
+	const EntityStore& scene, const Bvh& bvh, const StaticBatcher* staticBatches, Shader& depthShader)
+{
+	readTimers();
+
+	// Clip planes of the camera, read back from its perspective projection
+	float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+	float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+	float distance = std::min(zFar, shadowDistance);
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec3 axis = glm::normalize(lightDirection);
+	glm::vec3 up = std::abs(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), axis, up);
+
+	GLint viewport[4] = {};
+	bool bound = false;
+	float splitNear = zNear;
+	for (unsigned int c = 0; c < cascadeCount; c++)
+	{
+		float t = (float)(c + 1) / cascadeCount;
+		float splitFar = glm::mix(zNear + (distance - zNear) * t, zNear * std::pow(distance / zNear, t), splitBlend);
+		fit(c, inverseViewProjection, zNear, zFar, splitNear, splitFar, lightView);
+		splitNear = splitFar;
+
+		Cascade& cascade = cascades[c];
+		cascade.stats.rendered = false;
+		bool changed = cullShadowCasters(Frustum::FromMatrix(cascade.projection * cascade.lightView), scene, bvh, NO_ENTITY,
+			cascade.casters, culled);
+		if (!cascade.dirty && !changed)
+			continue;
+
+		if (!bound)
+		{
+			// Casters in front of the near plane are clamped onto it instead of clipped
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+			glState.setEnabled(GL_DEPTH_TEST, true);
+			glState.setEnabled(GL_BLEND, false);
+			glState.setEnabled(GL_CULL_FACE, false);
+			glState.setEnabled(GL_DEPTH_CLAMP, true);
+			glState.setEnabled(GL_POLYGON_OFFSET_FILL, true);
+			glState.depthMask(true);
+			glState.depthFunc(GL_LESS);
+			glPolygonOffset(CASCADE_OFFSET_FACTOR, CASCADE_OFFSET_UNITS);
+			glViewport(0, 0, resolution, resolution);
+			glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, uniformBuffer, MAX_SHADOW_CASCADES * frameDataStride, sizeof(DrawData));
+			depthShader.use();
+			bound = true;
+		}
+		cascade.casters.swap(culled);
+		render(c, scene, staticBatches);
+		cascade.dirty = false;
+		cascade.stats.rendered = true;
+		cascade.stats.casters = (unsigned int)cascade.casters.size();
+	}
+
+	if (bound)
+	{
+		glState.setEnabled(GL_DEPTH_CLAMP, false);
+		glState.setEnabled(GL_POLYGON_OFFSET_FILL, false);
+		glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+	timerFrame = (timerFrame + 1) % RING_BUFFER_FRAMES;
+}
+
+void CascadedShadowMaps::render(unsigned int c, const EntityStore& scene, const StaticBatcher* staticBatches)
+{
+	Cascade& cascade = cascades[c];
+	cascade.draws.build(cascade.casters, scene, cascade.center, staticBatches);
+
+	FrameData frameData = FrameData();
+	frameData.view = cascade.lightView;
+	frameData.projection = cascade.projection;
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, c * frameDataStride, sizeof(FrameData), &frameData);
+	renderStats.countBufferUpload(sizeof(FrameData));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, uniformBuffer, c * frameDataStride, sizeof(FrameData));
+
+	if (timerQueries[timerFrame][0] == 0)
+		glGenQueries(MAX_SHADOW_CASCADES, timerQueries[timerFrame]);
+	glBeginQuery(GL_TIME_ELAPSED, timerQueries[timerFrame][c]);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, c);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glState.bindVertexArray(cascade.VAO);
+	cascade.draws.draw(0, cascade.draws.commandCount());
+	glEndQuery(GL_TIME_ELAPSED);
+	timerIssued[timerFrame][c] = true;
+}
+
+void CascadedShadowMaps::readTimers()
+{
+	// Timers of this slot were issued RING_BUFFER_FRAMES updates ago, results that are not ready are dropped
+	for (unsigned int c = 0; c < MAX_SHADOW_CASCADES; c++)
+	{
+		if (!timerIssued[timerFrame][c])
+			continue;
+		GLuint available = 0;
+		glGetQueryObjectuiv(timerQueries[timerFrame][c], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(timerQueries[timerFrame][c], GL_QUERY_RESULT, &nanoseconds);
+			cascades[c].stats.gpuMilliseconds = nanoseconds / 1.0e6f;
+		}
+		timerIssued[timerFrame][c] = false;
+	}
+}
+
+CascadeData CascadedShadowMaps::data(const glm::mat4& view) const
+{
+	CascadeData cascadeData = CascadeData();
+	cascadeData.count = cascadeCount;
+	cascadeData.texelSize = 1.0f / resolution;
+	glm::mat4 inverseView = glm::inverse(view);
+	// Clip space of the light to texture coordinates, depth to [0, 1]
+	glm::mat4 toTexture = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+	for (unsigned int c = 0; c < cascadeCount; c++)
+	{
+		cascadeData.matrices[c] = toTexture * cascades[c].projection * cascades[c].lightView * inverseView;
+		cascadeData.splits[c] = cascades[c].stats.splitFar;
+		cascadeData.worldTexelSizes[c] = cascades[c].stats.worldTexelSize;
+	}
+	return cascadeData;
+}
+
+void CascadedShadowMaps::bindTexture() const
+{
+	glState.bindTexture(CASCADE_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthTexture);
+}
@@ -0,0 +1,104 @@
+#ifndef CASCADEDSHADOWS_H
+#define CASCADEDSHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "bufferallocator.h"
+#include "bvh.h"
+#include "entities.h"
+#include "framedata.h"
+#include "indirect.h"
+#include "meshpool.h"
+#include "ringbuffer.h"
+#include "shader.h"
+#include "staticbatch.h"
+
+// The cascade texture array is sampled from this unit, after the cluster textures
+const unsigned int CASCADE_TEXTURE_UNIT = 11;
+
+struct CascadeStats
+{
+	float splitFar = 0.0f;          // view depth where the cascade ends
+	float worldTexelSize = 0.0f;    // world size of one of its texels
+	unsigned int casters = 0;
+	bool rendered = false;          // drawn by the last update(), false when its depth was reused
+	// GPU time of its last draw, RING_BUFFER_FRAMES frames late. Kept while the cascade is reused.
+	float gpuMilliseconds = 0.0f;
+};
+
+// Shadow of the directional light, one depth layer per slice of the camera frustum. The splits
+// blend between even and logarithmic spacing up to the shadow distance.
+// Each cascade is fitted to the sphere around its slice, which keeps the same size however the
+// camera turns, and its center moves in whole texels of the light view. Edges therefore do not
+// crawl, and the cascade matrix only changes after the camera moved by a texel. Casters are culled
+// per cascade, reaching back towards the light, and like the spot light tiles a cascade is drawn
+// again only when its matrix or its casters changed. Every draw is timed with a GL_TIME_ELAPSED
+// query read back a few frames later.
+class CascadedShadowMaps
+{
+public:
+	CascadedShadowMaps() {}
+	CascadedShadowMaps(const CascadedShadowMaps&) = delete;
+	CascadedShadowMaps& operator=(const CascadedShadowMaps&) = delete;
+
+	void create(const MeshPool& pool, BufferAllocator* instanceStorage, unsigned int cascadeCount, unsigned int resolution);
+	// Recreates the depth layers, every cascade is drawn on the next update()
+	void configure(unsigned int cascadeCount, unsigned int resolution);
+	void setShadowDistance(float distance) { shadowDistance = distance; }
+	// 0 spaces the splits evenly, 1 logarithmically
+	void setSplitBlend(float blend) { splitBlend = blend; }
+
+	// Fits the cascades to the camera frustum and draws the ones that are out of date with the
+	// depth shader. Changes the framebuffer, viewport and the FrameData and DrawData bindings.
+	void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightDirection,
+		const EntityStore& scene, const Bvh& bvh, const StaticBatcher* staticBatches, Shader& depthShader);
+
+	// Cascade matrices for the view space of the camera
+	CascadeData data(const glm::mat4& view) const;
+	void bindTexture() const;
+
+	unsigned int getCascadeCount() const { return cascadeCount; }
+	unsigned int getResolution() const { return resolution; }
+	const CascadeStats& stats(unsigned int cascade) const { return cascades[cascade].stats; }
+
+private:
+	struct Cascade
+	{
+		glm::mat4 lightView = glm::mat4(1.0f);
+		glm::mat4 projection = glm::mat4(1.0f);
+		glm::vec3 center = glm::vec3(0.0f);
+		std::vector<Entity> casters;        // sorted, as of the last time the cascade was drawn
+		IndirectDrawList draws;
+		unsigned int VAO = 0;
+		bool dirty = true;
+		CascadeStats stats;
+	};
+
+	void fit(unsigned int cascade, const glm::mat4& inverseViewProjection, float zNear, float zFar,
+		float splitNear, float splitFar, const glm::mat4& lightView);
+	void render(unsigned int cascade, const EntityStore& scene, const StaticBatcher* staticBatches);
+	void readTimers();
+
+	const MeshPool* pool = nullptr;
+	BufferAllocator* instanceStorage = nullptr;
+	Cascade cascades[MAX_SHADOW_CASCADES];
+	unsigned int cascadeCount = 0;
+	unsigned int resolution = 0;
+	float shadowDistance = 50.0f;
+	float splitBlend = 0.75f;
+	std::vector<Entity> culled;
+
+	unsigned int FBO = 0;
+	unsigned int depthTexture = 0;
+	unsigned int uniformBuffer = 0;     // FrameData of each cascade, then the DrawData all share
+	size_t frameDataStride = 0;
+
+	unsigned int timerQueries[RING_BUFFER_FRAMES][MAX_SHADOW_CASCADES] = {};
+	bool timerIssued[RING_BUFFER_FRAMES][MAX_SHADOW_CASCADES] = {};
+	unsigned int timerFrame = 0;
+};
+
+#endif
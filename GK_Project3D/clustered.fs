@@ -0,0 +1,124 @@
+#version 330 core
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    sampler2D normal;
+};
+
+#include "framedata.glsl"
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 Normal;
+    vec3 Tangent;
+    float fogFactor;
+} fs_in;
+
+out vec4 FragColor;
+
+uniform Material material;
+// Filled by LightClusters every frame
+uniform samplerBuffer clusterLights;    // 6 texels per light, laid out like SpotLight
+uniform usamplerBuffer clusterGrid;     // first index and light count per cluster
+uniform usamplerBuffer clusterIndices;
+
+#include "dirshadow.glsl"
+#include "spotshadow.glsl"
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
+SpotLight FetchLight(int index);
+
+
+void main()
+{
+    vec3 norm = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    if (normalMapping)
+    {
+        // Tangent space normal moved to view space, where the lights are
+        vec3 T = normalize(fs_in.Tangent - dot(fs_in.Tangent, norm) * norm);
+        vec3 mapped = texture(material.normal, fs_in.TexCoords).rgb * 2.0 - 1.0;
+        norm = normalize(mat3(T, cross(norm, T), norm) * mapped);
+    }
+
+    vec3 surfaceNormal = normalize(fs_in.Normal);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, DirShadow(fs_in.FragPos, surfaceNormal));
+
+    // Only the lights binned into this pixel's cluster
+    uint slice = uint(clamp(log(-fs_in.FragPos.z) * sliceScale + sliceBias, 0.0, float(slices - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * tileScale), uvec2(tilesX, tilesY) - 1u);
+    int cluster = int(tile.x + tilesX * (tile.y + tilesY * slice));
+    uvec2 list = texelFetch(clusterGrid, cluster).rg;
+    for (uint i = 0u; i < list.y; i++)
+    {
+        int light = int(texelFetch(clusterIndices, int(list.x + i)).r);
+        result += CalcSpotLight(FetchLight(light), norm, fs_in.FragPos, viewDir, SpotShadow(light, fs_in.FragPos, surfaceNormal));
+    }
+
+    result = mix(fogColor, result, fs_in.fogFactor);
+    FragColor = vec4(result, 1.0);
+}
+
+
+SpotLight FetchLight(int index)
+{
+    int texel = index * 6;
+    vec4 position = texelFetch(clusterLights, texel);
+    vec4 direction = texelFetch(clusterLights, texel + 1);
+    vec4 ambient = texelFetch(clusterLights, texel + 2);
+    vec4 diffuse = texelFetch(clusterLights, texel + 3);
+    vec4 specular = texelFetch(clusterLights, texel + 4);
+    float range = texelFetch(clusterLights, texel + 5).x;
+    return SpotLight(position.xyz, position.w, direction.xyz, direction.w,
+        ambient.rgb, ambient.w, diffuse.rgb, diffuse.w, specular.rgb, specular.w, range);
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
+{
+    vec3 lightDir = normalize(-light.direction);
+    
+    // Ambient
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, fs_in.TexCoords));
+
+    // Diffuse
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fs_in.TexCoords));
+
+    // Specular
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
+
+    return (ambient + (diffuse + specular) * shadow);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+
+    // Ambient
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, fs_in.TexCoords));
+
+    // Diffuse
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, fs_in.TexCoords));
+
+    // Specular
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
+
+    // Attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    // Intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+    return (ambient + (diffuse + specular) * shadow) * attenuation * intensity;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 5) in mat4 aInstanceModel;
+
+#include "framedata.glsl"
+
+// Matches the depth pre-pass bit for bit
+invariant gl_Position;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 Normal;
+    vec3 Tangent;
+    float fogFactor;
+} vs_out;
+
+
+void main()
+{
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    mat4 modelView = view * modelMatrix;
+
+    vs_out.FragPos = vec3(modelView * vec4(aPos, 1.0));
+    vs_out.TexCoords = aTexCoords;
+    vs_out.Normal = mat3(transpose(inverse(modelView))) * aNormal;
+    vs_out.Tangent = mat3(modelView) * aTangent;
+
+    // FOG
+    vec4 worldPosition = modelMatrix * vec4(aPos, 1.0);
+    float distance = length(worldPosition.xyz - cameraPos);
+    float density = 0.05;
+    vs_out.fogFactor = clamp(exp(-pow(density * distance, 2.0)), 0.0, 1.0);
+
+    gl_Position = projection * vec4(vs_out.FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "culling.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#endif
+
+
+bool boundsVisible(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = frustum.planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (distance + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+static unsigned int cullScalar(const Frustum& frustum, const BoundsColumns& bounds, unsigned int first, unsigned int count, unsigned int* visible)
+{
+	unsigned int visibleCount = 0;
+	for (unsigned int i = first; i < count; i++)
+	{
+		glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+		glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+		if (boundsVisible(frustum, center, extent))
+			visible[visibleCount++] = i;
+	}
+	return visibleCount;
+}
+
+unsigned int cullBounds(const Frustum& frustum, const BoundsColumns& bounds, unsigned int count, unsigned int* visible)
+{
+	unsigned int visibleCount = 0;
+	unsigned int i = 0;
+
+#if defined(CULLING_AVX)
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		absX[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].x));
+		absY[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].y));
+		absZ[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].z));
+	}
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(bounds.centerX + i);
+		__m256 cy = _mm256_loadu_ps(bounds.centerY + i);
+		__m256 cz = _mm256_loadu_ps(bounds.centerZ + i);
+		__m256 ex = _mm256_loadu_ps(bounds.extentX + i);
+		__m256 ey = _mm256_loadu_ps(bounds.extentY + i);
+		__m256 ez = _mm256_loadu_ps(bounds.extentZ + i);
+
+		// A box is outside when distance + radius < 0 for any plane
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absX[p], ex), _mm256_mul_ps(absY[p], ey)), _mm256_mul_ps(absZ[p], ez));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		int mask = ~_mm256_movemask_ps(outside) & 0xFF;
+		while (mask)
+		{
+			int bit = 0;
+			while (!(mask & (1 << bit)))
+				bit++;
+			visible[visibleCount++] = i + bit;
+			mask &= mask - 1;
+		}
+	}
+#elif defined(CULLING_SSE)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		absX[p] = _mm_set1_ps(std::fabs(frustum.planes[p].x));
+		absY[p] = _mm_set1_ps(std::fabs(frustum.planes[p].y));
+		absZ[p] = _mm_set1_ps(std::fabs(frustum.planes[p].z));
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(bounds.centerX + i);
+		__m128 cy = _mm_loadu_ps(bounds.centerY + i);
+		__m128 cz = _mm_loadu_ps(bounds.centerZ + i);
+		__m128 ex = _mm_loadu_ps(bounds.extentX + i);
+		__m128 ey = _mm_loadu_ps(bounds.extentY + i);
+		__m128 ez = _mm_loadu_ps(bounds.extentZ + i);
+
+		// A box is outside when distance + radius < 0 for any plane
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		int mask = ~_mm_movemask_ps(outside) & 0xF;
+		if (mask & 1) visible[visibleCount++] = i;
+		if (mask & 2) visible[visibleCount++] = i + 1;
+		if (mask & 4) visible[visibleCount++] = i + 2;
+		if (mask & 8) visible[visibleCount++] = i + 3;
+	}
+#endif
+
+	// Remainder, or everything without SIMD
+	return visibleCount + cullScalar(frustum, bounds, i, count, visible + visibleCount);
+}
@@ -0,0 +1,25 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "camera.h"
+
+// World space AABBs given as center and half extent columns
+struct BoundsColumns
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* extentX;
+	const float* extentY;
+	const float* extentZ;
+};
+
+// Tests count boxes against the frustum and writes the indices of the ones that are
+// at least partially inside to visible (room for count indices), in increasing order.
+// Returns the number of visible boxes. Uses AVX (8 boxes) or SSE (4 boxes) per step when available.
+unsigned int cullBounds(const Frustum& frustum, const BoundsColumns& bounds, unsigned int count, unsigned int* visible);
+
+// Same test one box at a time, for single queries and as the reference for the batch version
+bool boundsVisible(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent);
+
+#endif
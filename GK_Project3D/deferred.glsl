@@ -0,0 +1,25 @@
+// Helpers of the deferred lighting shaders. The including shader declares the FrameData block
+// and the gDepth sampler first.
+
+vec3 decodeNormal(vec2 f)
+{
+    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// View space position of the pixel, rebuilt from its depth and the projection
+vec3 viewPosition(ivec2 pixel, float depth)
+{
+    vec3 ndc = vec3((vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0)), depth) * 2.0 - 1.0;
+    float z = -projection[3][2] / (ndc.z + projection[2][2]);
+    vec2 xy = (ndc.xy * -z - projection[2].xy * z) / vec2(projection[0][0], projection[1][1]);
+    return vec3(xy, z);
+}
+
+float fogFactor(vec3 fragPos)
+{
+    float density = 0.05;
+    return clamp(exp(-pow(density * length(fragPos), 2.0)), 0.0, 1.0);
+}
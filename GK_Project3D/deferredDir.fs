@@ -0,0 +1,42 @@
+#version 330 core
+
+#include "framedata.glsl"
+
+out vec4 FragColor;
+
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+
+#include "deferred.glsl"
+
+#include "dirshadow.glsl"
+
+
+// Ambient and directional light of every pixel, also blends in the fog the spot lights leave out
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0)
+        discard;
+
+    vec3 fragPos = viewPosition(pixel, depth);
+    vec3 normal = decodeNormal(texelFetch(gNormal, pixel, 0).rg);
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 lightDir = normalize(-dirLight.direction);
+
+    vec3 ambient = dirLight.ambient * albedo.rgb;
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = dirLight.diffuse * diff * albedo.rgb;
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = dirLight.specular * spec * albedo.a;
+
+    float shadow = DirShadow(fragPos, normal);
+
+    float fog = fogFactor(fragPos);
+    FragColor = vec4((ambient + (diffuse + specular) * shadow) * fog + fogColor * (1.0 - fog), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 330 core
+
+// Triangle covering the screen at the far plane. It is wound clockwise, the back face that
+// the lighting pass draws.
+void main()
+{
+    vec2 corner = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    gl_Position = vec4(corner.x, -corner.y, 1.0, 1.0);
+}
\ No newline at end of file
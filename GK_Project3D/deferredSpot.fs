@@ -0,0 +1,48 @@
+#version 330 core
+
+#include "framedata.glsl"
+
+flat in int light;
+
+out vec4 FragColor;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+
+#include "deferred.glsl"
+
+#include "spotshadow.glsl"
+
+// One spot light on the pixels its volume covers, fog is applied by scaling it down
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0)
+        discard;
+
+    SpotLight spot = spotLights[light];
+    vec3 fragPos = viewPosition(pixel, depth);
+    vec3 normal = decodeNormal(texelFetch(gNormal, pixel, 0).rg);
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 lightDir = normalize(spot.position - fragPos);
+
+    vec3 ambient = spot.ambient * albedo.rgb;
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = spot.diffuse * diff * albedo.rgb;
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = spot.specular * spec * albedo.a;
+
+    float distance = length(spot.position - fragPos);
+    float attenuation = 1.0 / (spot.constant + spot.linear * distance + spot.quadratic * (distance * distance));
+    float theta = dot(lightDir, normalize(-spot.direction));
+    float epsilon = spot.cutOff - spot.outerCutOff;
+    float intensity = clamp((theta - spot.outerCutOff) / epsilon, 0.0, 1.0);
+
+    float shadow = SpotShadow(light, fragPos, normal);
+
+    FragColor = vec4((ambient + (diffuse + specular) * shadow) * attenuation * intensity * fogFactor(fragPos), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+#include "framedata.glsl"
+
+flat out int light;
+
+// Unit cone along -Z scaled to the outer cone and range of the light instance. The range comes
+// from lightRange() on the CPU, like the light's clusters and shadow tile.
+void main()
+{
+    light = gl_InstanceID;
+    SpotLight spot = spotLights[gl_InstanceID];
+
+    float range = spot.range;
+    float cosine = max(spot.outerCutOff, 0.05);
+    float radius = range * sqrt(1.0 - cosine * cosine) / cosine;
+
+    vec3 axis = normalize(spot.direction);
+    vec3 side = normalize(cross(axis, abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 up = cross(side, axis);
+    vec3 position = spot.position + (side * aPos.x + up * aPos.y) * radius - axis * aPos.z * range;
+
+    gl_Position = projection * vec4(position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Only depth is written, color writes are masked
+void main()
+{
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+#include "framedata.glsl"
+
+// Must compute gl_Position exactly like the shading pass, which tests depth with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    vec3 FragPos = vec3(view * modelMatrix * vec4(aPos, 1.0));
+    gl_Position = projection * vec4(FragPos, 1.0);
+}
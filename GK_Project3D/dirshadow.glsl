@@ -0,0 +1,22 @@
+// Directional light shadows from the cascades, see cascadedshadows.h. The including shader
+// declares the CascadeData block first (framedata.glsl).
+
+uniform sampler2DArrayShadow cascadeMaps;
+
+// Part of the directional light that reaches fragPos, from the first cascade that covers it and a
+// 3x3 grid of compared taps. Nothing past the last cascade is shadowed.
+float DirShadow(vec3 fragPos, vec3 normal)
+{
+    int cascade = 0;
+    while (cascade < int(cascadeCount) && -fragPos.z > cascadeSplits[cascade])
+        cascade++;
+    if (cascade >= int(cascadeCount))
+        return 1.0;
+    vec3 coords = (cascadeMatrices[cascade] * vec4(fragPos + normal * cascadeWorldTexelSizes[cascade] * 1.5, 1.0)).xyz;
+
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            lit += texture(cascadeMaps, vec4(coords.xy + vec2(x, y) * cascadeTexelSize, float(cascade), coords.z));
+    return lit / 9.0;
+}
@@ -0,0 +1,170 @@
+#include "dynamicresolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "gbuffer.h"
+#include "glstate.h"
+#include "renderstats.h"
+
+void DynamicResolution::create(int outputWidth, int outputHeight)
+{
+	for (unsigned int frame = 0; frame < RING_BUFFER_FRAMES; frame++)
+		glGenQueries(2, timestamps[frame]);
+	resize(outputWidth, outputHeight);
+}
+
+void DynamicResolution::resize(int outputWidth, int outputHeight)
+{
+	// Minimized windows report a zero size
+	if (outputWidth <= 0 || outputHeight <= 0)
+		return;
+	this->outputWidth = outputWidth;
+	this->outputHeight = outputHeight;
+}
+
+void DynamicResolution::setPolicy(const DynamicResolutionPolicy& policy)
+{
+	this->policy = policy;
+	scale = std::min(std::max(scale, policy.minScale), policy.maxScale);
+	framesSinceChange = 0;
+	if (policy.log)
+	{
+		std::cout << "Dynamic resolution policy: " << policy.targetMilliseconds << " ms target, scale " << policy.minScale
+			<< " to " << policy.maxScale << " in steps of " << policy.step << ", lowered above " << policy.lowerAbove * 100.0f
+			<< "% and raised below " << policy.raiseBelow * 100.0f << "% of the target, " << policy.settleFrames
+			<< " frames between changes, sharpness " << policy.sharpness << std::endl;
+	}
+}
+
+void DynamicResolution::setEnabled(bool enabled)
+{
+	if (enabled == this->enabled)
+		return;
+	this->enabled = enabled;
+	framesSinceChange = 0;
+	if (policy.log)
+		std::cout << "Dynamic resolution " << (enabled ? "on" : "off") << std::endl;
+}
+
+void DynamicResolution::beginFrame()
+{
+	readTimers();
+	if (enabled)
+	{
+		adjustScale();
+		renderWidth = std::max((int)std::lround(outputWidth * scale), 1);
+		renderHeight = std::max((int)std::lround(outputHeight * scale), 1);
+		if (renderWidth != targetWidth || renderHeight != targetHeight)
+			createTarget();
+	}
+	else
+	{
+		renderWidth = outputWidth;
+		renderHeight = outputHeight;
+	}
+
+	glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer());
+	glViewport(0, 0, renderWidth, renderHeight);
+	glQueryCounter(timestamps[timerFrame][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::endFrame(Shader& upscaleShader, unsigned int screenTriangleVAO)
+{
+	if (enabled)
+	{
+		glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, outputWidth, outputHeight);
+		glState.setEnabled(GL_DEPTH_TEST, false);
+		upscaleShader.use();
+		upscaleShader.setFloat("sharpness", policy.sharpness);
+		glState.bindTexture(0, GL_TEXTURE_2D, colorTexture);
+		glState.bindVertexArray(screenTriangleVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		renderStats.countDraw(GL_TRIANGLES, 3);
+		glState.setEnabled(GL_DEPTH_TEST, true);
+	}
+
+	glQueryCounter(timestamps[timerFrame][1], GL_TIMESTAMP);
+	timerIssued[timerFrame] = true;
+	timerFrame = (timerFrame + 1) % RING_BUFFER_FRAMES;
+}
+
+void DynamicResolution::readTimers()
+{
+	// This slot was written RING_BUFFER_FRAMES frames ago, a result that is not ready is dropped
+	if (!timerIssued[timerFrame])
+		return;
+	timerIssued[timerFrame] = false;
+	GLuint available = 0;
+	glGetQueryObjectuiv(timestamps[timerFrame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	GLuint64 start = 0, end = 0;
+	glGetQueryObjectui64v(timestamps[timerFrame][0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(timestamps[timerFrame][1], GL_QUERY_RESULT, &end);
+	float milliseconds = (end - start) / 1.0e6f;
+	gpuMilliseconds = gpuMilliseconds > 0.0f ? gpuMilliseconds + (milliseconds - gpuMilliseconds) * policy.smoothing : milliseconds;
+}
+
+void DynamicResolution::adjustScale()
+{
+	if (++framesSinceChange < policy.settleFrames || gpuMilliseconds <= 0.0f)
+		return;
+
+	float target = policy.targetMilliseconds;
+	float next = scale;
+	if (gpuMilliseconds > target * policy.lowerAbove)
+		next = std::min(scale - policy.step, scale * std::sqrt(target / gpuMilliseconds));
+	else if (gpuMilliseconds < target * policy.raiseBelow)
+		next = scale + policy.step;
+	next = std::round(next / policy.step) * policy.step;
+	next = std::min(std::max(next, policy.minScale), policy.maxScale);
+	if (std::abs(next - scale) < policy.step * 0.5f)
+		return;
+
+	if (policy.log)
+	{
+		std::cout << "Dynamic resolution: " << std::lround(scale * 100.0f) << "% -> " << std::lround(next * 100.0f) << "% ("
+			<< std::lround(outputWidth * next) << "x" << std::lround(outputHeight * next) << "), GPU " << gpuMilliseconds
+			<< " ms for a " << target << " ms target" << std::endl;
+	}
+	scale = next;
+	framesSinceChange = 0;
+}
+
+void DynamicResolution::createTarget()
+{
+	// The depth format matches the G-buffer, whose depth is blitted in for the deferred lights and the sky
+	bool stencil = defaultFramebufferHasStencil();
+	if (FBO == 0)
+	{
+		glGenFramebuffers(1, &FBO);
+		glGenTextures(1, &colorTexture);
+		glGenTextures(1, &depthTexture);
+	}
+
+	glState.bindTexture(0, GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, renderWidth, renderHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glState.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+	if (stencil)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, renderWidth, renderHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, renderWidth, renderHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::DYNAMIC_RESOLUTION::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	targetWidth = renderWidth;
+	targetHeight = renderHeight;
+}
@@ -0,0 +1,83 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <glad/glad.h>
+
+#include "ringbuffer.h"
+#include "shader.h"
+
+// How the render scale follows the GPU frame time
+struct DynamicResolutionPolicy
+{
+	float targetMilliseconds = 1000.0f / 60.0f;
+	float minScale = 0.5f;              // of the output width and height
+	float maxScale = 1.0f;
+	float step = 0.05f;                 // scales are whole steps, so the target is reallocated rarely
+	float lowerAbove = 1.0f;            // part of the target above which the scale goes down
+	float raiseBelow = 0.8f;            // and below which it goes up one step
+	float smoothing = 0.2f;             // weight of a new frame in the averaged GPU time
+	unsigned int settleFrames = 12;     // frames between changes, longer than the timer latency
+	float sharpness = 0.25f;            // of the upscale filter, 0 is plain bilinear
+	bool log = true;                    // prints the policy and every change of the scale
+};
+
+// Renders the scene into an offscreen target of a fraction of the window size and stretches it
+// over the window with a sharpening filter. A timestamp query at the start and the end of each
+// frame measures its GPU time, read back RING_BUFFER_FRAMES frames later. While the averaged
+// time stays over budget the scale drops, by the square root of the overshoot since the cost
+// follows the pixel count, and it climbs back one step at a time once there is headroom.
+// Disabled, the scene is drawn straight into the window and the GPU time is still measured.
+class DynamicResolution
+{
+public:
+	DynamicResolution() {}
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	void create(int outputWidth, int outputHeight);
+	// Window framebuffer size
+	void resize(int outputWidth, int outputHeight);
+	void setPolicy(const DynamicResolutionPolicy& policy);
+	const DynamicResolutionPolicy& getPolicy() const { return policy; }
+	void setEnabled(bool enabled);
+	bool isEnabled() const { return enabled; }
+
+	// Adjusts the scale from the timers, binds the scene target and sets the viewport to it
+	void beginFrame();
+	// Draws the scene target over the window with the upscale shader and an empty VAO
+	void endFrame(Shader& upscaleShader, unsigned int screenTriangleVAO);
+
+	// 0 while disabled, the window itself
+	unsigned int framebuffer() const { return enabled ? FBO : 0; }
+	int getRenderWidth() const { return renderWidth; }
+	int getRenderHeight() const { return renderHeight; }
+	float getScale() const { return enabled ? scale : 1.0f; }
+	float getGpuMilliseconds() const { return gpuMilliseconds; }
+
+private:
+	void readTimers();
+	void adjustScale();
+	void createTarget();
+
+	DynamicResolutionPolicy policy;
+	bool enabled = false;
+	float scale = 1.0f;
+	unsigned int framesSinceChange = 0;
+	float gpuMilliseconds = 0.0f;       // averaged
+	int outputWidth = 0;
+	int outputHeight = 0;
+	int renderWidth = 0;
+	int renderHeight = 0;
+
+	unsigned int FBO = 0;
+	unsigned int colorTexture = 0;
+	unsigned int depthTexture = 0;
+	int targetWidth = 0;
+	int targetHeight = 0;
+
+	unsigned int timestamps[RING_BUFFER_FRAMES][2] = {};
+	bool timerIssued[RING_BUFFER_FRAMES] = {};
+	unsigned int timerFrame = 0;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.h"
+#include "material.h"
+#include "transform.h"
+
+typedef unsigned int Entity;
+typedef unsigned int MeshHandle;
+
+const Entity NO_ENTITY = NO_TRANSFORM;
+const MeshHandle NO_MESH = 0xFFFFFFFF;
+const unsigned int NO_STATIC_BATCH = 0xFFFFFFFF;
+
+// Scene objects stored as structure of arrays, an entity is an index into every column.
+// Update, culling and draw list building walk the columns they need front to back.
+class EntityStore
+{
+public:
+	// Position, rotation, scale, parent and cached matrices. Entity and transform handles are the same.
+	TransformSystem transforms;
+
+	std::vector<MeshHandle> mesh;
+	std::vector<MaterialHandle> material;
+	std::vector<unsigned int> staticBatch;      // merged batch drawn in place of the entity, see StaticBatcher
+
+	// Mesh space bounds
+	std::vector<glm::vec3> localCenter;
+	std::vector<glm::vec3> localExtent;
+
+	// World space bounds (AABB), kept as separate columns for batch tests
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	Entity create(MeshHandle meshHandle, MaterialHandle materialHandle,
+		const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+		const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f),
+		Entity parent = NO_ENTITY)
+	{
+		Entity entity = transforms.create(parent, position, rotation, scale);
+		mesh.push_back(meshHandle);
+		material.push_back(materialHandle);
+		staticBatch.push_back(NO_STATIC_BATCH);
+		localCenter.push_back((boundsMin + boundsMax) * 0.5f);
+		localExtent.push_back((boundsMax - boundsMin) * 0.5f);
+		centerX.push_back(0.0f);
+		centerY.push_back(0.0f);
+		centerZ.push_back(0.0f);
+		extentX.push_back(0.0f);
+		extentY.push_back(0.0f);
+		extentZ.push_back(0.0f);
+		return entity;
+	}
+
+	unsigned int count() const { return (unsigned int)mesh.size(); }
+
+	// Updates moved transforms and the world bounds of everything they moved
+	void update()
+	{
+		transforms.update();
+		for (Entity entity : transforms.changed())
+		{
+			const glm::mat4& world = transforms.world(entity);
+			glm::vec3 center = glm::vec3(world * glm::vec4(localCenter[entity], 1.0f));
+			glm::mat3 absolute = glm::mat3(glm::abs(world[0]), glm::abs(world[1]), glm::abs(world[2]));
+			glm::vec3 extent = absolute * localExtent[entity];
+
+			centerX[entity] = center.x;
+			centerY[entity] = center.y;
+			centerZ[entity] = center.z;
+			extentX[entity] = extent.x;
+			extentY[entity] = extent.y;
+			extentZ[entity] = extent.z;
+		}
+	}
+
+	glm::vec3 worldCenter(Entity entity) const { return glm::vec3(centerX[entity], centerY[entity], centerZ[entity]); }
+	glm::vec3 worldExtent(Entity entity) const { return glm::vec3(extentX[entity], extentY[entity], extentZ[entity]); }
+	BoundsColumns bounds() const
+	{
+		return { centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data() };
+	}
+};
+
+#endif
@@ -0,0 +1,79 @@
+// GLSL side of the std140 uniform blocks in framedata.h, which must match it member for member.
+// Shaders include what they need of it, blocks a shader does not read stay inactive.
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+
+    float range;
+};
+
+// Written once per frame
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float shininess;
+    vec3 cameraPos;
+    vec3 lightPos;
+    vec3 fogColor;
+    DirLight dirLight;
+    SpotLight spotLight;
+    SpotLight spotLightMoving;
+};
+
+// What changes between draws of one frame
+layout (std140) uniform DrawData {
+    mat4 model;
+    bool instanced;
+    bool normalMapping;
+};
+
+// One entry per light volume instance of the deferred path, MAX_SPOT_LIGHTS in framedata.h
+layout (std140) uniform LightData {
+    SpotLight spotLights[32];
+};
+
+// Cluster grid of this frame, see lightclusters.h
+layout (std140) uniform ClusterData {
+    uint tilesX;
+    uint tilesY;
+    uint slices;
+    uint lightCount;
+    vec2 tileScale;     // clusters per pixel
+    float sliceScale;   // slice = log(view depth) * sliceScale + sliceBias
+    float sliceBias;
+};
+
+// Spot light shadow tiles, light i of a light list owns tile i when i < shadowCount, see shadowatlas.h
+layout (std140) uniform ShadowData {
+    mat4 shadowMatrices[16];    // view space to atlas coordinates and depth
+    uint shadowCount;
+    float shadowTexelSize;
+};
+
+// Directional light shadow cascades, nearest first, see cascadedshadows.h
+layout (std140) uniform CascadeData {
+    mat4 cascadeMatrices[4];        // view space to cascade texture coordinates and depth
+    vec4 cascadeSplits;             // view depth where each cascade ends
+    vec4 cascadeWorldTexelSizes;
+    uint cascadeCount;
+    float cascadeTexelSize;
+};
@@ -0,0 +1,112 @@
+#ifndef FRAMEDATA_H
+#define FRAMEDATA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform block binding points shared by every shader
+const unsigned int FRAME_DATA_BINDING = 0;
+const unsigned int DRAW_DATA_BINDING = 1;
+const unsigned int LIGHT_DATA_BINDING = 2;
+const unsigned int CLUSTER_DATA_BINDING = 3;
+const unsigned int SHADOW_DATA_BINDING = 4;
+const unsigned int CASCADE_DATA_BINDING = 5;
+// Spot lights the deferred path can light a frame with, one light volume instance each
+const unsigned int MAX_SPOT_LIGHTS = 32;
+// Tiles of the spot light shadow atlas, see shadowatlas.h
+const unsigned int MAX_SHADOW_TILES = 16;
+// Cascades of the directional light shadow, see cascadedshadows.h
+const unsigned int MAX_SHADOW_CASCADES = 4;
+
+// C++ copies of the std140 uniform blocks in the shaders. A vec3 takes 16 bytes, so the
+// scalar declared after it in GLSL fills its last 4.
+
+struct DirLightData
+{
+	glm::vec3 direction; float padding0;
+	glm::vec3 ambient; float padding1;
+	glm::vec3 diffuse; float padding2;
+	glm::vec3 specular; float padding3;
+};
+
+struct SpotLightData
+{
+	glm::vec3 position; float cutOff;
+	glm::vec3 direction; float outerCutOff;
+	glm::vec3 ambient; float constant;
+	glm::vec3 diffuse; float linear;
+	glm::vec3 specular; float quadratic;
+	float range; float padding[3];      // set from lightRange() whenever the light changes
+};
+
+// Camera, fog and lights, written once per frame (block FrameData)
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos; float shininess;
+	glm::vec3 cameraPos; float padding0;
+	glm::vec3 lightPos; float padding1;
+	glm::vec3 fogColor; float padding2;
+	DirLightData dirLight;
+	SpotLightData spotLight;
+	SpotLightData spotLightMoving;
+};
+
+// What changes between draws of one frame (block DrawData)
+struct DrawData
+{
+	glm::mat4 model;
+	GLuint instanced;
+	GLuint normalMapping;
+	GLuint padding[2];
+};
+
+// Lights of the deferred path (block LightData), only the first spot light count entries are read
+struct LightData
+{
+	SpotLightData spotLights[MAX_SPOT_LIGHTS];
+};
+
+// Cluster grid of the clustered forward path (block ClusterData), see lightclusters.h
+struct ClusterData
+{
+	GLuint tilesX;
+	GLuint tilesY;
+	GLuint slices;
+	GLuint lightCount;
+	glm::vec2 tileScale;    // clusters per pixel
+	float sliceScale;       // slice = log(view depth) * sliceScale + sliceBias
+	float sliceBias;
+};
+
+// Shadowed spot lights (block ShadowData). Light i of a light list owns tile i when i < count.
+struct ShadowData
+{
+	glm::mat4 matrices[MAX_SHADOW_TILES];   // view space to atlas coordinates and depth
+	GLuint count;
+	float texelSize;                        // of the atlas, for the filter taps
+	GLuint padding[2];
+};
+
+// Directional light shadow cascades (block CascadeData), nearest first
+struct CascadeData
+{
+	glm::mat4 matrices[MAX_SHADOW_CASCADES];    // view space to cascade texture coordinates and depth
+	glm::vec4 splits;                           // view depth where each cascade ends
+	glm::vec4 worldTexelSizes;                  // of each cascade, scales the normal offset
+	GLuint count;
+	float texelSize;                            // of the cascade textures, for the filter taps
+	GLuint padding[2];
+};
+
+static_assert(sizeof(DirLightData) == 64, "DirLightData must match the std140 layout");
+static_assert(sizeof(SpotLightData) == 96, "SpotLightData must match the std140 layout");
+static_assert(sizeof(FrameData) == 448, "FrameData must match the std140 layout");
+static_assert(sizeof(DrawData) == 80, "DrawData must match the std140 layout");
+static_assert(sizeof(LightData) == MAX_SPOT_LIGHTS * 96, "LightData must match the std140 layout");
+static_assert(sizeof(ClusterData) == 32, "ClusterData must match the std140 layout");
+static_assert(sizeof(ShadowData) == MAX_SHADOW_TILES * 64 + 16, "ShadowData must match the std140 layout");
+static_assert(sizeof(CascadeData) == MAX_SHADOW_CASCADES * 64 + 48, "CascadeData must match the std140 layout");
+
+#endif
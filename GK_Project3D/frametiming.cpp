@@ -0,0 +1,198 @@
+#include "frametiming.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "profiler.h"
+
+unsigned int FrameTimeHistogram::bucket(uint64_t microseconds)
+{
+	microseconds = std::min(microseconds, (uint64_t)0xFFFFFFFF);
+	if (microseconds < 64)
+		return (unsigned int)microseconds;
+	// The top 6 bits pick the bucket within the power of two
+	unsigned int shift = 0;
+	while ((microseconds >> shift) >= 64)
+		shift++;
+	return 64 + (shift - 1) * 32 + (unsigned int)(microseconds >> shift) - 32;
+}
+
+uint64_t FrameTimeHistogram::bucketEnd(unsigned int bucket)
+{
+	if (bucket < 64)
+		return bucket;
+	unsigned int shift = (bucket - 64) / 32 + 1;
+	uint64_t top = 32 + (bucket - 64) % 32;
+	return ((top + 1) << shift) - 1;
+}
+
+void FrameTimeHistogram::add(uint64_t microseconds)
+{
+	counts[bucket(microseconds)]++;
+	total++;
+	if (budget > 0 && microseconds > budget)
+		over++;
+	maxMicroseconds = std::max(maxMicroseconds, microseconds);
+}
+
+float FrameTimeHistogram::percentile(float fraction) const
+{
+	if (total == 0)
+		return 0.0f;
+	uint64_t target = std::max((uint64_t)std::ceil(fraction * total), (uint64_t)1);
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= target)
+			return std::min(bucketEnd(i), maxMicroseconds) / 1000.0f;
+	}
+	return max();
+}
+
+void FrameTiming::setBudget(float milliseconds)
+{
+	budgetMilliseconds = milliseconds;
+	uint64_t microseconds = (uint64_t)(milliseconds * 1000.0f);
+	cpuTimes.setBudget(microseconds);
+	gpuTimes.setBudget(microseconds);
+	presentIntervals.setBudget(microseconds);
+}
+
+void FrameTiming::beginFrame()
+{
+	frameStart = profilerNow();
+	firstEvent = profilerThreadBuffer().written.load(std::memory_order_relaxed);
+}
+
+void FrameTiming::endCpuFrame()
+{
+	uint64_t microseconds = (profilerNow() - frameStart) / 1000;
+	// Compared with the frames before, so a spike does not raise its own bar
+	float median = cpuTimes.percentile(0.5f);
+	bool settled = cpuTimes.count() >= 30;
+	cpuTimes.add(microseconds);
+
+	float milliseconds = microseconds / 1000.0f;
+	if (settled && milliseconds > budgetMilliseconds && milliseconds > spikeFactor * median)
+	{
+		FrameSpike spike;
+		spike.frame = frame;
+		spike.cpuMilliseconds = milliseconds;
+		spike.medianMilliseconds = median;
+		attribute(spike);
+		std::cout << "Frame spike: frame " << spike.frame << " took " << spike.cpuMilliseconds << " ms on the CPU (median "
+			<< spike.medianMilliseconds << " ms), " << (spike.zones.empty() ? "no profiler zones" : spike.zones.c_str());
+		if (!spike.zones.empty())
+			std::cout << " " << spike.zoneMilliseconds << " ms";
+		if (!spike.detail.empty())
+			std::cout << " (" << spike.detail << ")";
+		std::cout << std::endl;
+		keepSpike(spike);
+	}
+	frame++;
+}
+
+void FrameTiming::presented()
+{
+	uint64_t now = profilerNow();
+	if (lastPresent != 0)
+		presentIntervals.add((now - lastPresent) / 1000);
+	lastPresent = now;
+}
+
+void FrameTiming::addGpuFrame(float milliseconds)
+{
+	gpuTimes.add((uint64_t)(milliseconds * 1000.0f));
+}
+
+void FrameTiming::attribute(FrameSpike& spike) const
+{
+	// Zones of the main thread that ended during this frame. Zones still open, like the one
+	// around the whole frame, are not written yet.
+	const ProfileThreadBuffer& buffer = profilerThreadBuffer();
+	uint64_t written = buffer.written.load(std::memory_order_relaxed);
+	uint64_t first = std::max(firstEvent, written > PROFILER_EVENTS_PER_THREAD ? written - PROFILER_EVENTS_PER_THREAD : 0);
+	const ProfileEvent* outer = nullptr;
+	while (true)
+	{
+		const ProfileEvent* longest = nullptr;
+		for (uint64_t i = first; i < written; i++)
+		{
+			const ProfileEvent& event = buffer.events[i % PROFILER_EVENTS_PER_THREAD];
+			if (event.start < frameStart || &event == outer)
+				continue;
+			if (outer != nullptr && (event.start < outer->start || event.start + event.duration > outer->start + outer->duration))
+				continue;
+			if (longest == nullptr || event.duration > longest->duration)
+				longest = &event;
+		}
+		if (longest == nullptr || (outer != nullptr && longest->duration * 2 < outer->duration))
+			break;
+		spike.zones += (outer != nullptr ? " > " : "") + std::string(longest->name);
+		spike.detail = longest->detail;
+		spike.zoneMilliseconds = longest->duration / 1.0e6f;
+		outer = longest;
+	}
+}
+
+void FrameTiming::keepSpike(const FrameSpike& spike)
+{
+	spikesSeen++;
+	if (frameSpikes.size() < MAX_SPIKES)
+	{
+		frameSpikes.push_back(spike);
+		return;
+	}
+	auto shortest = std::min_element(frameSpikes.begin(), frameSpikes.end(),
+		[](const FrameSpike& a, const FrameSpike& b) { return a.cpuMilliseconds < b.cpuMilliseconds; });
+	if (shortest->cpuMilliseconds < spike.cpuMilliseconds)
+		*shortest = spike;
+}
+
+void FrameTiming::print() const
+{
+	const char* names[] = { "CPU", "GPU", "present" };
+	const FrameTimeHistogram* histograms[] = { &cpuTimes, &gpuTimes, &presentIntervals };
+	std::cout << "Frame times in ms (p50 / p90 / p99 / p99.9 / max), frames over the " << budgetMilliseconds << " ms budget:" << std::endl;
+	for (int i = 0; i < 3; i++)
+	{
+		const FrameTimeHistogram& histogram = *histograms[i];
+		std::cout << "  " << names[i] << ": " << histogram.percentile(0.5f) << " / " << histogram.percentile(0.9f) << " / "
+			<< histogram.percentile(0.99f) << " / " << histogram.percentile(0.999f) << " / " << histogram.max() << ", "
+			<< histogram.overBudget() << " of " << histogram.count() << " over" << std::endl;
+	}
+	std::cout << "  " << spikesSeen << " spikes" << std::endl;
+}
+
+bool FrameTiming::writeCsv(const std::string& histogramPath, const std::string& spikesPath) const
+{
+	std::ofstream csv(histogramPath.c_str());
+	std::ofstream spikesCsv(spikesPath.c_str());
+	if (!csv.good() || !spikesCsv.good())
+		return false;
+
+	const char* names[] = { "cpu", "gpu", "present" };
+	const FrameTimeHistogram* histograms[] = { &cpuTimes, &gpuTimes, &presentIntervals };
+	csv << "series,frames,p50_ms,p90_ms,p99_ms,p99.9_ms,max_ms,budget_ms,over_budget\n";
+	for (int i = 0; i < 3; i++)
+	{
+		const FrameTimeHistogram& histogram = *histograms[i];
+		csv << names[i] << "," << histogram.count() << "," << histogram.percentile(0.5f) << "," << histogram.percentile(0.9f) << ","
+			<< histogram.percentile(0.99f) << "," << histogram.percentile(0.999f) << "," << histogram.max() << ","
+			<< budgetMilliseconds << "," << histogram.overBudget() << "\n";
+	}
+
+	// Zones and details can hold commas, they are quoted
+	std::vector<FrameSpike> ordered = frameSpikes;
+	std::sort(ordered.begin(), ordered.end(), [](const FrameSpike& a, const FrameSpike& b) { return a.frame < b.frame; });
+	spikesCsv << "frame,cpu_ms,median_ms,zones,zone_ms,detail\n";
+	for (const FrameSpike& spike : ordered)
+	{
+		spikesCsv << spike.frame << "," << spike.cpuMilliseconds << "," << spike.medianMilliseconds << ",\"" << spike.zones << "\","
+			<< spike.zoneMilliseconds << ",\"" << spike.detail << "\"\n";
+	}
+	return csv.good() && spikesCsv.good();
+}
@@ -0,0 +1,94 @@
+#ifndef FRAMETIMING_H
+#define FRAMETIMING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame times in microseconds, exact below 64 us and then in 32 buckets per power of two, so
+// every percentile is within 3% of the true value. Reaches a little over an hour.
+class FrameTimeHistogram
+{
+public:
+	static const unsigned int BUCKETS = 64 + 32 * 26;
+
+	void add(uint64_t microseconds);
+	// Upper edge of the bucket holding the given fraction of the frames, never above max()
+	float percentile(float fraction) const;
+	float max() const { return maxMicroseconds / 1000.0f; }
+	uint64_t count() const { return total; }
+	uint64_t overBudget() const { return over; }
+	void setBudget(uint64_t microseconds) { budget = microseconds; }
+
+private:
+	static unsigned int bucket(uint64_t microseconds);
+	static uint64_t bucketEnd(unsigned int bucket);
+
+	uint32_t counts[BUCKETS] = {};
+	uint64_t total = 0;
+	uint64_t over = 0;
+	uint64_t maxMicroseconds = 0;
+	uint64_t budget = 0;
+};
+
+// A frame much slower than usual and the zone of the CPU profiler its time went to
+struct FrameSpike
+{
+	uint64_t frame = 0;
+	float cpuMilliseconds = 0.0f;
+	float medianMilliseconds = 0.0f;    // of the frames before it
+	std::string zones;                  // outermost to innermost, "processInput > loadTexture"
+	std::string detail;                 // of the innermost zone, a file path
+	float zoneMilliseconds = 0.0f;      // of the innermost zone
+};
+
+// Histograms of the CPU time of each frame (from the start of the loop to the buffer swap), the
+// GPU time of each frame and the interval between presents. A frame whose CPU time is over
+// budget and several times the median so far is kept as a spike, together with the chain of
+// profiler zones of the main thread that took most of it: from the longest zone of the frame
+// down through the longest zone inside, while that still holds half of its parent.
+class FrameTiming
+{
+public:
+	static const unsigned int MAX_SPIKES = 64;      // the longest ones are kept
+
+	void setBudget(float milliseconds);
+	// A spike is this many times the median CPU time, which needs some frames to settle
+	void setSpikeFactor(float factor) { spikeFactor = factor; }
+
+	void beginFrame();
+	// Before the buffer swap, ends the CPU time of the frame
+	void endCpuFrame();
+	// After the buffer swap
+	void presented();
+	// GPU time of a frame, read back whenever it arrives
+	void addGpuFrame(float milliseconds);
+
+	const FrameTimeHistogram& cpu() const { return cpuTimes; }
+	const FrameTimeHistogram& gpu() const { return gpuTimes; }
+	const FrameTimeHistogram& present() const { return presentIntervals; }
+	const std::vector<FrameSpike>& spikes() const { return frameSpikes; }
+
+	void print() const;
+	// One row per histogram, and one per spike in the second file. False when one failed to open.
+	bool writeCsv(const std::string& histogramPath, const std::string& spikesPath) const;
+
+private:
+	void attribute(FrameSpike& spike) const;
+	void keepSpike(const FrameSpike& spike);
+
+	FrameTimeHistogram cpuTimes;
+	FrameTimeHistogram gpuTimes;
+	FrameTimeHistogram presentIntervals;
+	std::vector<FrameSpike> frameSpikes;
+	uint64_t spikesSeen = 0;
+	float budgetMilliseconds = 1000.0f / 60.0f;
+	float spikeFactor = 3.0f;
+
+	uint64_t frame = 0;
+	uint64_t frameStart = 0;
+	uint64_t firstEvent = 0;            // main thread profiler events written before this frame
+	uint64_t lastPresent = 0;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "gbuffer.h"
+
+#include <iostream>
+
+#include "glstate.h"
+
+static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState.bindTexture(GBUFFER_TEXTURE_UNIT, GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+bool defaultFramebufferHasStencil()
+{
+	GLint stencilType = GL_NONE, stencilBits = 0;
+	glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &stencilType);
+	if (stencilType != GL_NONE)
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+	return stencilBits > 0;
+}
+
+bool GBuffer::create(int width, int height)
+{
+	destroy();
+	this->width = width;
+	this->height = height;
+
+	// Depth blits need the exact format of the default framebuffer
+	bool stencil = defaultFramebufferHasStencil();
+
+	if (stencil)
+		depthTexture = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+	else
+		depthTexture = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+	normalTexture = createTarget(GL_RG16F, GL_RG, GL_HALF_FLOAT, width, height);
+	albedoTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+
+	glGenFramebuffers(1, &FBO);
+	glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, albedoTexture, 0);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (!complete)
+		std::cout << "ERROR::GBUFFER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+void GBuffer::resize(int width, int height)
+{
+	if (width == this->width && height == this->height)
+		return;
+	// Minimized windows report a zero size
+	if (width > 0 && height > 0)
+		create(width, height);
+}
+
+void GBuffer::clear()
+{
+	glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::bindTextures() const
+{
+	glState.bindTexture(GBUFFER_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+	glState.bindTexture(GBUFFER_TEXTURE_UNIT + 1, GL_TEXTURE_2D, normalTexture);
+	glState.bindTexture(GBUFFER_TEXTURE_UNIT + 2, GL_TEXTURE_2D, albedoTexture);
+}
+
+void GBuffer::destroy()
+{
+	if (FBO == 0)
+		return;
+	glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &FBO);
+	unsigned int textures[] = { depthTexture, normalTexture, albedoTexture };
+	glDeleteTextures(3, textures);
+	FBO = depthTexture = normalTexture = albedoTexture = 0;
+	// The cache may still hold the deleted names, names get reused
+	for (unsigned int unit = GBUFFER_TEXTURE_UNIT; unit < GBUFFER_TEXTURE_UNIT + 3; unit++)
+		glState.bindTexture(unit, GL_TEXTURE_2D, 0);
+}
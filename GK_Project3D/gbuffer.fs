@@ -0,0 +1,47 @@
+#version 330 core
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    sampler2D normal;
+};
+
+#include "framedata.glsl"
+
+in VS_OUT {
+    vec2 TexCoords;
+    vec3 Normal;
+    vec3 Tangent;
+} fs_in;
+
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedo;
+
+uniform Material material;
+
+// Folds the unit sphere onto the [-1, 1] square, the lower half is mirrored into the corners
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+
+void main()
+{
+    vec3 norm = normalize(fs_in.Normal);
+    if (normalMapping)
+    {
+        // Tangent space normal moved to view space
+        vec3 T = normalize(fs_in.Tangent - dot(fs_in.Tangent, norm) * norm);
+        vec3 B = cross(norm, T);
+        vec3 mapped = texture(material.normal, fs_in.TexCoords).rgb * 2.0 - 1.0;
+        norm = normalize(mat3(T, B, norm) * mapped);
+    }
+
+    gNormal = encodeNormal(norm);
+    gAlbedo.rgb = texture(material.diffuse, fs_in.TexCoords).rgb;
+    gAlbedo.a = dot(texture(material.specular, fs_in.TexCoords).rgb, vec3(1.0 / 3.0));
+}
\ No newline at end of file
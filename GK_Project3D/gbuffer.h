@@ -0,0 +1,49 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+
+// The G-buffer textures are bound to this unit and the two after it (depth, normal, albedo),
+// above the units materials use
+const unsigned int GBUFFER_TEXTURE_UNIT = 4;
+
+// Whether the default framebuffer has a stencil buffer, offscreen depth must match its format to be blitted
+bool defaultFramebufferHasStencil();
+
+// Surface attributes of the deferred path, 8 bytes per pixel besides depth:
+//   depth    the depth buffer itself, view space positions are rebuilt from it
+//   normal   RG16F, view space normal folded onto an octahedron
+//   albedo   RGBA8, diffuse color in rgb and specular intensity in a
+// The depth format matches the default framebuffer, so depth can be blitted into it for the
+// light volumes and the sky.
+class GBuffer
+{
+public:
+	GBuffer() {}
+	GBuffer(const GBuffer&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+
+	bool create(int width, int height);
+	// Recreates the textures when the size changed
+	void resize(int width, int height);
+
+	// Binds the framebuffer and clears every attachment
+	void clear();
+	void bindTextures() const;
+
+	unsigned int framebuffer() const { return FBO; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+private:
+	void destroy();
+
+	unsigned int FBO = 0;
+	unsigned int depthTexture = 0;
+	unsigned int normalTexture = 0;
+	unsigned int albedoTexture = 0;
+	int width = 0;
+	int height = 0;
+};
+
+#endif
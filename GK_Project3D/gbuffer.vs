@@ -0,0 +1,34 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 5) in mat4 aInstanceModel;
+
+#include "framedata.glsl"
+
+// Must compute gl_Position exactly like the depth pre-pass, which the lighting tests with GL_EQUAL.
+// Invariance only holds for the same expression, so it is written as in depth.vs.
+invariant gl_Position;
+
+out VS_OUT {
+    vec2 TexCoords;
+    vec3 Normal;
+    vec3 Tangent;
+} vs_out;
+
+
+void main()
+{
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    mat4 modelView = view * modelMatrix;
+    mat3 normalMatrix = mat3(transpose(inverse(modelView)));
+    vec3 FragPos = vec3(view * modelMatrix * vec4(aPos, 1.0));
+
+    vs_out.TexCoords = aTexCoords;
+    vs_out.Normal = normalMatrix * aNormal;
+    vs_out.Tangent = mat3(modelView) * aTangent;
+
+    gl_Position = projection * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "glstate.h"
+
+GLStateCache glState;
+
+// Value no real state has, the first call after invalidate() is always issued
+const unsigned int UNKNOWN_STATE = 0xFFFFFFFF;
+
+unsigned int StateCallCounters::totalIssued() const
+{
+	unsigned int total = 0;
+	for (unsigned int count : issued)
+		total += count;
+	return total;
+}
+
+unsigned int StateCallCounters::totalElided() const
+{
+	unsigned int total = 0;
+	for (unsigned int count : elided)
+		total += count;
+	return total;
+}
+
+void GLStateCache::invalidate()
+{
+	program = UNKNOWN_STATE;
+	vertexArray = UNKNOWN_STATE;
+	activeUnit = UNKNOWN_STATE;
+	for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+	{
+		textures2D[unit] = UNKNOWN_STATE;
+		texturesCube[unit] = UNKNOWN_STATE;
+	}
+	depthFunction = UNKNOWN_STATE;
+	depthTest = UNKNOWN_STATE;
+	blend = UNKNOWN_STATE;
+	faceCulling = UNKNOWN_STATE;
+	blendSource = UNKNOWN_STATE;
+	blendDestination = UNKNOWN_STATE;
+	colorWrites = UNKNOWN_STATE;
+	depthWrites = UNKNOWN_STATE;
+	culledFace = UNKNOWN_STATE;
+	drawFramebuffer = UNKNOWN_STATE;
+	readFramebuffer = UNKNOWN_STATE;
+}
+
+// Stores the new value, returns whether the GL call has to be made
+bool GLStateCache::update(StateCall call, unsigned int& current, unsigned int value)
+{
+	if (current == value)
+	{
+		callCounters.elided[call]++;
+		return false;
+	}
+	current = value;
+	callCounters.issued[call]++;
+	return true;
+}
+
+void GLStateCache::useProgram(unsigned int program)
+{
+	if (update(STATE_CALL_PROGRAM, this->program, program))
+		glUseProgram(program);
+}
+
+void GLStateCache::bindVertexArray(unsigned int VAO)
+{
+	if (update(STATE_CALL_VERTEX_ARRAY, vertexArray, VAO))
+		glBindVertexArray(VAO);
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	unsigned int* bound = target == GL_TEXTURE_CUBE_MAP ? texturesCube : textures2D;
+	if (unit >= TEXTURE_UNITS || (target != GL_TEXTURE_2D && target != GL_TEXTURE_CUBE_MAP))
+	{
+		// Not shadowed, set it directly and forget what the unit held
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		callCounters.issued[STATE_CALL_ACTIVE_TEXTURE]++;
+		callCounters.issued[STATE_CALL_TEXTURE]++;
+		return;
+	}
+
+	if (!update(STATE_CALL_TEXTURE, bound[unit], texture))
+		return;
+	if (update(STATE_CALL_ACTIVE_TEXTURE, activeUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texture);
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+	if (update(STATE_CALL_DEPTH_FUNC, depthFunction, func))
+		glDepthFunc(func);
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled)
+{
+	unsigned int untracked = UNKNOWN_STATE;
+	unsigned int& current = capability == GL_DEPTH_TEST ? depthTest : (capability == GL_BLEND ? blend : (capability == GL_CULL_FACE ? faceCulling : untracked));
+	if (!update(STATE_CALL_CAPABILITY, current, enabled ? 1 : 0))
+		return;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+	if (blendSource == source && blendDestination == destination)
+	{
+		callCounters.elided[STATE_CALL_BLEND_FUNC]++;
+		return;
+	}
+	blendSource = source;
+	blendDestination = destination;
+	callCounters.issued[STATE_CALL_BLEND_FUNC]++;
+	glBlendFunc(source, destination);
+}
+
+void GLStateCache::colorMask(bool enabled)
+{
+	if (update(STATE_CALL_WRITE_MASK, colorWrites, enabled ? 1 : 0))
+		glColorMask(enabled, enabled, enabled, enabled);
+}
+
+void GLStateCache::depthMask(bool enabled)
+{
+	if (update(STATE_CALL_WRITE_MASK, depthWrites, enabled ? 1 : 0))
+		glDepthMask(enabled);
+}
+
+void GLStateCache::cullFace(GLenum face)
+{
+	if (update(STATE_CALL_CULL_FACE, culledFace, face))
+		glCullFace(face);
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, unsigned int framebuffer)
+{
+	if (target == GL_FRAMEBUFFER)
+	{
+		if (drawFramebuffer == framebuffer && readFramebuffer == framebuffer)
+		{
+			callCounters.elided[STATE_CALL_FRAMEBUFFER]++;
+			return;
+		}
+		drawFramebuffer = framebuffer;
+		readFramebuffer = framebuffer;
+		callCounters.issued[STATE_CALL_FRAMEBUFFER]++;
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		return;
+	}
+
+	unsigned int& current = target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer;
+	if (update(STATE_CALL_FRAMEBUFFER, current, framebuffer))
+		glBindFramebuffer(target, framebuffer);
+}
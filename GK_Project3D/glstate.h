@@ -0,0 +1,86 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+// Kinds of calls counted by the state cache
+enum StateCall
+{
+	STATE_CALL_PROGRAM,
+	STATE_CALL_VERTEX_ARRAY,
+	STATE_CALL_ACTIVE_TEXTURE,
+	STATE_CALL_TEXTURE,
+	STATE_CALL_DEPTH_FUNC,
+	STATE_CALL_CAPABILITY,
+	STATE_CALL_BLEND_FUNC,
+	STATE_CALL_WRITE_MASK,
+	STATE_CALL_CULL_FACE,
+	STATE_CALL_FRAMEBUFFER,
+	STATE_CALL_COUNT
+};
+
+struct StateCallCounters
+{
+	unsigned int issued[STATE_CALL_COUNT] = {};
+	unsigned int elided[STATE_CALL_COUNT] = {};
+
+	unsigned int totalIssued() const;
+	unsigned int totalElided() const;
+};
+
+// Shadow copy of the GL state the renderer changes. Calls that would set the value that is
+// already current are skipped. Every bind in the program goes through the global glState,
+// a GL call made around it leaves the copy stale until invalidate().
+class GLStateCache
+{
+public:
+	static const unsigned int TEXTURE_UNITS = 16;
+
+	GLStateCache() { invalidate(); }
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int VAO);
+	// Binds to GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP of a texture unit (0 is GL_TEXTURE0)
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+	void depthFunc(GLenum func);
+	// Tracks GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE, other capabilities are always set
+	void setEnabled(GLenum capability, bool enabled);
+	void blendFunc(GLenum source, GLenum destination);
+	// Color writes of all four channels together
+	void colorMask(bool enabled);
+	void depthMask(bool enabled);
+	void cullFace(GLenum face);
+	// GL_FRAMEBUFFER sets both the draw and the read framebuffer
+	void bindFramebuffer(GLenum target, unsigned int framebuffer);
+
+	// Forgets everything, the next call of each kind is issued
+	void invalidate();
+
+	const StateCallCounters& counters() const { return callCounters; }
+	void resetCounters() { callCounters = StateCallCounters(); }
+
+private:
+	bool update(StateCall call, unsigned int& current, unsigned int value);
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int activeUnit;
+	unsigned int textures2D[TEXTURE_UNITS];
+	unsigned int texturesCube[TEXTURE_UNITS];
+	unsigned int depthFunction;
+	unsigned int depthTest;
+	unsigned int blend;
+	unsigned int faceCulling;
+	unsigned int blendSource;
+	unsigned int blendDestination;
+	unsigned int colorWrites;
+	unsigned int depthWrites;
+	unsigned int culledFace;
+	unsigned int drawFramebuffer;
+	unsigned int readFramebuffer;
+	StateCallCounters callCounters;
+};
+
+extern GLStateCache glState;
+
+#endif
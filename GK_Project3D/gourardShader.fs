@@ -6,7 +6,7 @@ in vec3 vertexColor;
 
 out vec4 FragColor;
 
-uniform vec3 fogColor;
+#include "framedata.glsl"
 
 void main()
 {
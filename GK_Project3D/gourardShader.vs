@@ -3,50 +3,22 @@
 struct Material {
     sampler2D diffuse;
     sampler2D specular;
-    float shininess;
 };
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-
-    float cutOff;
-    float outerCutOff;
-  
-    float constant;
-    float linear;
-    float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
-};
+#include "framedata.glsl"
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstanceModel;
+
+// Matches the depth pre-pass bit for bit
+invariant gl_Position;
 
 out vec2 TexCoords;
 out float fogFactor;
 out vec3 vertexColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 cameraPos;
-
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform SpotLight spotLight;
-uniform SpotLight spotLightMoving;
 uniform Material material;
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -54,8 +26,10 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
 {
-    vec3 FragPos = vec3(view * model * vec4(aPos, 1.0));
-    vec3 Normal = normalize(mat3(transpose(inverse(view * model))) * aNormal);
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+
+    vec3 FragPos = vec3(view * modelMatrix * vec4(aPos, 1.0));
+    vec3 Normal = normalize(mat3(transpose(inverse(view * modelMatrix))) * aNormal);
     vec3 viewDir = normalize(viewPos - FragPos);
 
     TexCoords = aTexCoords;
@@ -66,7 +40,7 @@ void main()
 
     vertexColor = color;
     
-    vec4 worldPosition = model * vec4(aPos, 1.0);
+    vec4 worldPosition = modelMatrix * vec4(aPos, 1.0);
     float distance = length(worldPosition.xyz - cameraPos);
     float density = 0.05;
     fogFactor = clamp(exp(-pow(density * distance, 2.0)), 0.0, 1.0);
@@ -75,7 +49,6 @@ void main()
 }
 
 
-
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
     vec3 lightDir = normalize(-light.direction);
@@ -89,7 +62,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 
     // Specular
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     vec3 specular = light.specular * spec * vec3(textureLod(material.specular, TexCoords, 0.0).rgb);
 
     return (ambient + diffuse + specular);
@@ -108,7 +81,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
     // Specular
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     vec3 specular = light.specular * spec * vec3(textureLod(material.specular, TexCoords, 0.0).rgb);
     
     // Attenuation
@@ -0,0 +1,171 @@
+#include "gpuprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const unsigned int NO_ZONE = 0xFFFFFFFF;
+
+void GpuProfiler::create()
+{
+	for (Slot& slot : slots)
+		glGenQueries(2 * GPU_PROFILER_MAX_ZONES, slot.queries);
+#ifdef PROFILER_ENABLED
+	track = &createProfilerTrack("GPU", "gpu");
+#endif
+}
+
+void GpuProfiler::beginFrame()
+{
+	Slot& slot = slots[frame];
+	if (slot.issued)
+		readSlot(slot);
+	slot.issued = false;
+	slot.count = 0;
+	slot.queriesUsed = 0;
+	open.clear();
+
+	// The GPU clock now, next to the CPU clock now, lines the two up for the trace
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	slot.gpuToCpu = (int64_t)profilerNow() - (int64_t)gpuNow;
+}
+
+void GpuProfiler::endFrame()
+{
+	while (!open.empty())
+		endZone();
+	Slot& slot = slots[frame];
+	slot.issued = slot.count > 0;
+	frame = (frame + 1) % RING_BUFFER_FRAMES;
+}
+
+void GpuProfiler::beginZone(const char* name)
+{
+	Slot& slot = slots[frame];
+	if (slot.count == GPU_PROFILER_MAX_ZONES)
+	{
+		open.push_back(NO_ZONE);
+		return;
+	}
+	TimedZone& timed = slot.timed[slot.count];
+	timed.zone = zoneIndex(name);
+	timed.depth = (unsigned int)open.size();
+	timed.startQuery = slot.queries[slot.queriesUsed++];
+	timed.endQuery = 0;
+	glQueryCounter(timed.startQuery, GL_TIMESTAMP);
+	open.push_back(slot.count++);
+}
+
+void GpuProfiler::endZone()
+{
+	if (open.empty())
+		return;
+	unsigned int index = open.back();
+	open.pop_back();
+	if (index == NO_ZONE)
+		return;
+	Slot& slot = slots[frame];
+	TimedZone& timed = slot.timed[index];
+	timed.endQuery = slot.queries[slot.queriesUsed++];
+	glQueryCounter(timed.endQuery, GL_TIMESTAMP);
+}
+
+const GpuZoneStats* GpuProfiler::find(const char* name) const
+{
+	for (const GpuZoneStats& stats : zoneStats)
+	{
+		if (strcmp(stats.name, name) == 0)
+			return &stats;
+	}
+	return nullptr;
+}
+
+unsigned int GpuProfiler::zoneIndex(const char* name)
+{
+	for (unsigned int i = 0; i < zoneStats.size(); i++)
+	{
+		if (zoneStats[i].name == name || strcmp(zoneStats[i].name, name) == 0)
+			return i;
+	}
+	GpuZoneStats stats;
+	stats.name = name;
+	zoneStats.push_back(stats);
+	zones.push_back(Zone());
+	return (unsigned int)zones.size() - 1;
+}
+
+void GpuProfiler::readSlot(Slot& slot)
+{
+	// Timestamps are written in order, once the last one is there all of them are
+	GLuint available = 0;
+	glGetQueryObjectuiv(slot.queries[slot.queriesUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	for (unsigned int i = 0; i < slot.count; i++)
+	{
+		const TimedZone& timed = slot.timed[i];
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(timed.startQuery, GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(timed.endQuery, GL_QUERY_RESULT, &end);
+		if (end < start)
+			continue;
+		zoneStats[timed.zone].depth = timed.depth;
+		updateStats(timed.zone, (end - start) / 1.0e6f);
+		if (track != nullptr)
+		{
+			int64_t cpuStart = (int64_t)start + slot.gpuToCpu, cpuEnd = (int64_t)end + slot.gpuToCpu;
+			if (cpuStart >= 0)
+				recordProfileEvent(*track, zoneStats[timed.zone].name, nullptr, (uint64_t)cpuStart, (uint64_t)cpuEnd);
+		}
+	}
+}
+
+void GpuProfiler::updateStats(unsigned int zone, float milliseconds)
+{
+	Zone& history = zones[zone];
+	history.history[history.samples % GPU_PROFILER_HISTORY] = milliseconds;
+	history.samples++;
+
+	unsigned int count = std::min(history.samples, GPU_PROFILER_HISTORY);
+	sorted.assign(history.history, history.history + count);
+	std::sort(sorted.begin(), sorted.end());
+	float sum = 0.0f;
+	for (float value : sorted)
+		sum += value;
+
+	GpuZoneStats& stats = zoneStats[zone];
+	stats.samples = count;
+	stats.results++;
+	stats.last = milliseconds;
+	stats.min = sorted.front();
+	stats.average = sum / count;
+	stats.p99 = sorted[(unsigned int)std::ceil(0.99f * count) - 1];
+}
+
+void GpuProfiler::print() const
+{
+	std::cout << "GPU zones, milliseconds over the last " << GPU_PROFILER_HISTORY << " frames (last / min / avg / p99):" << std::endl;
+	for (const GpuZoneStats& stats : zoneStats)
+	{
+		std::cout << std::string(2 + 2 * stats.depth, ' ') << stats.name << ": " << stats.last << " / " << stats.min << " / "
+			<< stats.average << " / " << stats.p99 << " (" << stats.samples << " frames)" << std::endl;
+	}
+}
+
+bool GpuProfiler::writeCsv(const std::string& path) const
+{
+	std::ofstream csv(path.c_str());
+	if (!csv.good())
+		return false;
+	csv << "zone,depth,samples,last_ms,min_ms,avg_ms,p99_ms\n";
+	for (const GpuZoneStats& stats : zoneStats)
+	{
+		csv << stats.name << "," << stats.depth << "," << stats.samples << "," << stats.last << "," << stats.min << ","
+			<< stats.average << "," << stats.p99 << "\n";
+	}
+	return csv.good();
+}
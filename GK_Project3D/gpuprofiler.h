@@ -0,0 +1,97 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+#include "ringbuffer.h"
+
+// Zones one frame can time, more are ignored
+const unsigned int GPU_PROFILER_MAX_ZONES = 32;
+// Frames of results behind the statistics of each zone
+const unsigned int GPU_PROFILER_HISTORY = 240;
+
+// Milliseconds over the last GPU_PROFILER_HISTORY frames the zone ran in
+struct GpuZoneStats
+{
+	const char* name = nullptr;
+	unsigned int depth = 0;         // zones it was nested in when last timed
+	unsigned int samples = 0;
+	uint64_t results = 0;           // read back since the start, a new one arrived when it grows
+	float last = 0.0f;
+	float min = 0.0f;
+	float average = 0.0f;
+	float p99 = 0.0f;
+};
+
+// GPU time of named zones of the frame, nested or not. Each zone is a pair of GL_TIMESTAMP
+// queries, which unlike GL_TIME_ELAPSED can nest and overlap the elapsed queries of other
+// timers. Every frame owns a slot of queries and reads back the slot issued RING_BUFFER_FRAMES
+// frames earlier, dropping it if the GPU is still not done with it, so reading never stalls.
+// The results also go to a "GPU" lane of the CPU trace, moved into CPU time by a GL_TIMESTAMP
+// read taken at the start of each frame.
+class GpuProfiler
+{
+public:
+	GpuProfiler() {}
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	void create();
+	// Reads back the oldest slot and starts this frame's
+	void beginFrame();
+	void endFrame();
+	// Zones are told apart by name, a string literal
+	void beginZone(const char* name);
+	void endZone();
+
+	// Ordered by first appearance
+	const std::vector<GpuZoneStats>& stats() const { return zoneStats; }
+	const GpuZoneStats* find(const char* name) const;
+	void print() const;
+	// One line per zone, returns false when the file could not be opened
+	bool writeCsv(const std::string& path) const;
+
+private:
+	struct TimedZone
+	{
+		unsigned int zone;          // index into zones
+		unsigned int depth;
+		unsigned int startQuery;
+		unsigned int endQuery;
+	};
+
+	struct Slot
+	{
+		unsigned int queries[2 * GPU_PROFILER_MAX_ZONES] = {};
+		TimedZone timed[GPU_PROFILER_MAX_ZONES];
+		unsigned int count = 0;
+		unsigned int queriesUsed = 0;
+		bool issued = false;
+		int64_t gpuToCpu = 0;       // nanoseconds added to GPU timestamps
+	};
+
+	struct Zone
+	{
+		float history[GPU_PROFILER_HISTORY];
+		unsigned int samples = 0;
+	};
+
+	unsigned int zoneIndex(const char* name);
+	void readSlot(Slot& slot);
+	void updateStats(unsigned int zone, float milliseconds);
+
+	Slot slots[RING_BUFFER_FRAMES];
+	unsigned int frame = 0;
+	std::vector<unsigned int> open;     // timed zone index of every open zone, NO_ZONE past the limit
+	std::vector<Zone> zones;
+	std::vector<GpuZoneStats> zoneStats;
+	std::vector<float> sorted;
+	ProfileThreadBuffer* track = nullptr;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "indirect.h"
+
+#include <glfw3.h>
+
+#include <algorithm>
+
+#include "renderstats.h"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// Not part of the GL 3.3 loader, fetched at run time
+typedef void (APIENTRYP PFN_MULTI_DRAW_ELEMENTS_INDIRECT)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+static PFN_MULTI_DRAW_ELEMENTS_INDIRECT multiDrawElementsIndirect = nullptr;
+
+bool loadIndirectDrawing()
+{
+	multiDrawElementsIndirect = nullptr;
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool core = major > 4 || (major == 4 && minor >= 3);
+	if (!core && !(glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance")))
+		return false;
+
+	multiDrawElementsIndirect = (PFN_MULTI_DRAW_ELEMENTS_INDIRECT)glfwGetProcAddress("glMultiDrawElementsIndirect");
+	return multiDrawElementsIndirect != nullptr;
+}
+
+bool indirectDrawingSupported()
+{
+	return multiDrawElementsIndirect != nullptr;
+}
+
+void IndirectDrawList::attach(const MeshPool& pool, BufferAllocator* instanceStorage, unsigned int VAO)
+{
+	this->pool = &pool;
+	this->VAO = VAO != 0 ? VAO : pool.vertexArray();
+	matrices.setStorage(instanceStorage);
+	matrices.attach(this->VAO);
+	if (commandBuffer == 0)
+		glGenBuffers(1, &commandBuffer);
+}
+
+void IndirectDrawList::build(const std::vector<Entity>& entities, const EntityStore& scene, const glm::vec3& eye, const StaticBatcher* staticBatches)
+{
+	sorted.clear();
+	if (staticBatches != nullptr)
+		batchDistance.assign(staticBatches->count(), -1.0f);
+	for (Entity entity : entities)
+	{
+		if (scene.mesh[entity] == NO_MESH)
+			continue;
+		float distance = glm::length(scene.worldCenter(entity) - eye);
+		unsigned int batch = scene.staticBatch[entity];
+		if (batch != NO_STATIC_BATCH && staticBatches != nullptr)
+		{
+			if (batchDistance[batch] < 0.0f || distance < batchDistance[batch])
+				batchDistance[batch] = distance;
+			continue;
+		}
+		sorted.push_back({ scene.material[entity], scene.mesh[entity], entity, distance });
+	}
+	for (unsigned int batch = 0; batch < batchDistance.size() && staticBatches != nullptr; batch++)
+	{
+		const StaticBatch& staticBatch = staticBatches->get(batch);
+		if (batchDistance[batch] >= 0.0f && staticBatch.mesh != NO_POOL_MESH)
+			sorted.push_back({ staticBatch.material, staticBatch.mesh, NO_TRANSFORM, batchDistance[batch] });
+	}
+
+	// Order by material, then mesh, so every material is one range and every mesh one command.
+	// Front to back only keeps neighbours of the same material or mesh together.
+	if (frontToBack)
+	{
+		std::sort(sorted.begin(), sorted.end(), [](const DrawItem& a, const DrawItem& b)
+		{
+			if (a.distance != b.distance)
+				return a.distance < b.distance;
+			if (a.material != b.material)
+				return a.material < b.material;
+			return a.mesh < b.mesh;
+		});
+	}
+	else
+	{
+		std::sort(sorted.begin(), sorted.end(), [](const DrawItem& a, const DrawItem& b)
+		{
+			if (a.material != b.material)
+				return a.material < b.material;
+			if (a.mesh != b.mesh)
+				return a.mesh < b.mesh;
+			return a.transform < b.transform;
+		});
+	}
+
+	// Matrix i belongs to sorted[i], only moved ones are re-sent while the list stays the same
+	sortedTransforms.clear();
+	for (const DrawItem& item : sorted)
+		sortedTransforms.push_back(item.transform);
+	matrices.sync(sortedTransforms, scene.transforms);
+	matrices.upload();
+
+	commands.clear();
+	materialBatches.clear();
+	for (unsigned int i = 0; i < sorted.size(); i++)
+	{
+		MaterialHandle material = sorted[i].material;
+		MeshHandle mesh = sorted[i].mesh;
+		if (materialBatches.empty() || materialBatches.back().material != material)
+			materialBatches.push_back({ material, (unsigned int)commands.size(), 0, sorted[i].distance });
+		else
+		{
+			IndirectBatch& batch = materialBatches.back();
+			batch.distance = std::min(batch.distance, sorted[i].distance);
+			if (sorted[i - 1].mesh == mesh)
+			{
+				commands.back().instanceCount++;
+				continue;
+			}
+		}
+
+		PoolMesh range = pool->get(mesh);
+		commands.push_back({ range.indexCount, 1, range.firstIndex, (GLint)range.baseVertex, i });
+		materialBatches.back().commandCount++;
+	}
+
+	if (!indirectDrawingSupported() || commands.empty())
+		return;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	if (commands.size() > commandCapacity)
+	{
+		commandCapacity = std::max(commands.size(), commandCapacity * 2);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	renderStats.countBufferUpload(commands.size() * sizeof(DrawElementsIndirectCommand));
+}
+
+void IndirectDrawList::draw(unsigned int firstCommand, unsigned int count)
+{
+	if (count == 0)
+		return;
+
+	if (indirectDrawingSupported())
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+			(void*)(firstCommand * sizeof(DrawElementsIndirectCommand)), count, sizeof(DrawElementsIndirectCommand));
+		uint64_t indices = 0;
+		for (unsigned int i = firstCommand; i < firstCommand + count; i++)
+			indices += (uint64_t)commands[i].count * commands[i].instanceCount;
+		renderStats.countDraw(GL_TRIANGLES, indices, 1, count);
+		return;
+	}
+
+	// No base instance either, so the matrix attributes are moved to each command's first matrix
+	for (unsigned int i = firstCommand; i < firstCommand + count; i++)
+	{
+		const DrawElementsIndirectCommand& command = commands[i];
+		matrices.attach(VAO, command.baseInstance);
+		glState.bindVertexArray(VAO);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+			(void*)(command.firstIndex * sizeof(GLuint)), command.instanceCount, command.baseVertex);
+		renderStats.countDraw(GL_TRIANGLES, command.count, command.instanceCount);
+	}
+	matrices.attach(VAO);
+	glState.bindVertexArray(VAO);
+}
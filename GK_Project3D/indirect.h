@@ -0,0 +1,86 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "entities.h"
+#include "instancing.h"
+#include "meshpool.h"
+#include "staticbatch.h"
+
+// One entry of the GL_DRAW_INDIRECT_BUFFER, as glMultiDrawElementsIndirect reads it
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Commands sharing a material, drawn with one call
+struct IndirectBatch
+{
+	MaterialHandle material;
+	unsigned int firstCommand;
+	unsigned int commandCount;
+	float distance;         // from the eye to the nearest object of the batch
+};
+
+// Loads glMultiDrawElementsIndirect through GLFW (GL 4.3, or ARB_multi_draw_indirect with
+// ARB_base_instance). Without it every command is drawn with glDrawElementsInstancedBaseVertex.
+bool loadIndirectDrawing();
+bool indirectDrawingSupported();
+
+// Draws of entities whose meshes live in a MeshPool, submitted with glMultiDrawElementsIndirect.
+// GLSL 3.30 has no gl_DrawID, so each command's baseInstance points at its first model matrix
+// and the matrices are read as instanced attributes. Entities with the same mesh and material
+// share one command.
+class IndirectDrawList
+{
+public:
+	// Uses the pool VAO and adds the model matrix attributes to it. The matrices live in a range
+	// of instanceStorage when given, otherwise in a buffer of their own. Lists drawn in the same
+	// frame need a VAO each, see MeshPool::createVertexArray().
+	void attach(const MeshPool& pool, BufferAllocator* instanceStorage = nullptr, unsigned int VAO = 0);
+	// Builds and uploads the commands and matrices of the entities, grouped by material. Members of
+	// a static batch are replaced by the batch, drawn once with an identity matrix.
+	void build(const std::vector<Entity>& entities, const EntityStore& scene, const glm::vec3& eye, const StaticBatcher* staticBatches = nullptr);
+	// Orders objects nearest first instead of by mesh. A batch is then a run of objects with the
+	// same material, so there are more of them and fewer instances per command.
+	void setFrontToBack(bool enabled) { frontToBack = enabled; }
+	bool isFrontToBack() const { return frontToBack; }
+	// Draws count commands of the last build, the list VAO must be bound
+	void draw(unsigned int firstCommand, unsigned int count);
+
+	unsigned int vertexArray() const { return VAO; }
+
+	const std::vector<IndirectBatch>& batches() const { return materialBatches; }
+	unsigned int commandCount() const { return (unsigned int)commands.size(); }
+
+private:
+	struct DrawItem
+	{
+		MaterialHandle material;
+		MeshHandle mesh;
+		TransformHandle transform;      // NO_TRANSFORM for static batches
+		float distance;
+	};
+
+	const MeshPool* pool = nullptr;
+	unsigned int VAO = 0;
+	InstanceBuffer matrices;
+	std::vector<DrawItem> sorted;
+	std::vector<TransformHandle> sortedTransforms;
+	std::vector<float> batchDistance;       // nearest visible member of each static batch, negative when none is visible
+	bool frontToBack = false;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<IndirectBatch> materialBatches;
+	unsigned int commandBuffer = 0;
+	size_t commandCapacity = 0;
+};
+
+#endif
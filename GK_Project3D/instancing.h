@@ -0,0 +1,197 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "bufferallocator.h"
+#include "glstate.h"
+#include "mesh.h"
+#include "renderstats.h"
+#include "transform.h"
+
+// First of the four vertex attribute locations taken by the per-instance model matrix
+const unsigned int INSTANCE_MODEL_LOCATION = 5;
+
+// Model matrices of many copies of one mesh, kept in a GL buffer and read per instance.
+// Only the range touched since the last upload() is sent to the GPU.
+class InstanceBuffer
+{
+public:
+	// Keeps the matrices in a range of a shared buffer instead of a buffer of their own.
+	// Must be set before the first attach().
+	void setStorage(BufferAllocator* allocator)
+	{
+		storage = allocator;
+		storageGeneration = allocator != nullptr ? allocator->generation() : 0;
+	}
+
+	// Adds the per-instance attributes to a mesh VAO
+	void attach(const Mesh& mesh)
+	{
+		attach(mesh.VAO);
+	}
+
+	// Adds the per-instance attributes to a VAO, its instance 0 reads the matrix at firstInstance
+	void attach(unsigned int VAO, unsigned int firstInstance = 0)
+	{
+		if (storage == nullptr && VBO == 0)
+			glGenBuffers(1, &VBO);
+		if (std::find(attached.begin(), attached.end(), VAO) == attached.end())
+			attached.push_back(VAO);
+
+		size_t first = baseOffset() + firstInstance * sizeof(glm::mat4);
+		glState.bindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, storage != nullptr ? storage->buffer() : VBO);
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+			glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+				(void*)(first + i * sizeof(glm::vec4)));
+			glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+		}
+		glState.bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	unsigned int add(const glm::mat4& model)
+	{
+		models.push_back(model);
+		markDirty((unsigned int)models.size() - 1);
+		return (unsigned int)models.size() - 1;
+	}
+
+	void set(unsigned int index, const glm::mat4& model)
+	{
+		models[index] = model;
+		markDirty(index);
+	}
+
+	void clear()
+	{
+		models.clear();
+		shown.clear();
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	// Makes the buffer hold the world matrices of the given transforms, in order, NO_TRANSFORM is
+	// the identity. While the list stays the same only the slots of transforms that moved in the
+	// last update are rewritten.
+	void sync(const std::vector<TransformHandle>& handles, const TransformSystem& transforms)
+	{
+		if (handles != shown)
+		{
+			clear();
+			for (TransformHandle handle : handles)
+				add(handle != NO_TRANSFORM ? transforms.world(handle) : glm::mat4(1.0f));
+			shown = handles;
+			return;
+		}
+		for (unsigned int i = 0; i < handles.size(); i++)
+		{
+			if (handles[i] != NO_TRANSFORM && transforms.changed(handles[i]))
+				set(i, transforms.world(handles[i]));
+		}
+	}
+
+	unsigned int count() const { return (unsigned int)models.size(); }
+	const glm::mat4& get(unsigned int index) const { return models[index]; }
+
+	// Sends changed matrices to the GPU, does nothing when no transform changed
+	void upload()
+	{
+		if (storage != nullptr)
+		{
+			uploadToStorage();
+			return;
+		}
+		if (dirtyBegin >= dirtyEnd)
+			return;
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (models.size() > capacity)
+		{
+			capacity = std::max(models.size(), capacity * 2);
+			glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+			dirtyBegin = 0;
+			dirtyEnd = (unsigned int)models.size();
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(glm::mat4), (dirtyEnd - dirtyBegin) * sizeof(glm::mat4), &models[dirtyBegin]);
+		renderStats.countBufferUpload((dirtyEnd - dirtyBegin) * sizeof(glm::mat4));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+private:
+	size_t baseOffset() const
+	{
+		return storage != nullptr && allocation != NO_ALLOCATION ? storage->offset(allocation) : 0;
+	}
+
+	// Growing takes a new range of the shared buffer, and a defragmentation may have moved
+	// the current one. Either way the attached VAOs are pointed at the new place. When the shared
+	// buffer has no room the matrices move to a buffer of their own for good.
+	void uploadToStorage()
+	{
+		bool moved = storage->generation() != storageGeneration;
+		storageGeneration = storage->generation();
+		if (models.size() > capacity)
+		{
+			capacity = std::max(models.size(), capacity * 2);
+			storage->free(allocation);
+			allocation = storage->allocate(capacity * sizeof(glm::mat4));
+			dirtyBegin = 0;
+			dirtyEnd = (unsigned int)models.size();
+			moved = true;
+			if (allocation == NO_ALLOCATION)
+			{
+				std::cout << "ERROR::INSTANCE_BUFFER::STORAGE_FULL " << capacity * sizeof(glm::mat4) << " bytes, using a buffer of its own" << std::endl;
+				storage = nullptr;
+				capacity = 0;
+				for (unsigned int VAO : attached)
+					attach(VAO);
+				upload();
+				return;
+			}
+		}
+		if (moved)
+		{
+			for (unsigned int VAO : attached)
+				attach(VAO);
+		}
+		if (dirtyBegin >= dirtyEnd)
+			return;
+
+		storage->write(allocation, dirtyBegin * sizeof(glm::mat4), (dirtyEnd - dirtyBegin) * sizeof(glm::mat4), &models[dirtyBegin]);
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	void markDirty(unsigned int index)
+	{
+		if (dirtyBegin >= dirtyEnd)
+		{
+			dirtyBegin = index;
+			dirtyEnd = index + 1;
+			return;
+		}
+		dirtyBegin = std::min(dirtyBegin, index);
+		dirtyEnd = std::max(dirtyEnd, index + 1);
+	}
+
+	std::vector<glm::mat4> models;
+	std::vector<TransformHandle> shown;     // transforms behind models when filled by sync()
+	unsigned int VBO = 0;
+	size_t capacity = 0;
+	BufferAllocator* storage = nullptr;
+	BufferAllocation allocation = NO_ALLOCATION;
+	unsigned int storageGeneration = 0;
+	std::vector<unsigned int> attached;     // VAOs to re-point when the storage range moves
+	unsigned int dirtyBegin = 0;
+	unsigned int dirtyEnd = 0;
+};
+
+#endif
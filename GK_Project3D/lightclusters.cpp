@@ -0,0 +1,292 @@
+#include "lightclusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "glstate.h"
+#include "renderstats.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLUSTERS_SSE
+#endif
+
+static_assert(MAX_CLUSTERED_LIGHTS <= 0x10000, "light indices are stored in 16 bits");
+static_assert(CLUSTER_TILES_X % 4 == 0, "rows of clusters are tested four at a time");
+
+// Light below this part of the brightest color is not drawn, it ends the light's reach
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+float lightRange(const SpotLightData& light)
+{
+	glm::vec3 color = light.ambient + light.diffuse + light.specular;
+	float brightest = std::max(std::max(color.r, color.g), color.b);
+	float c = light.constant - brightest / LIGHT_CUTOFF;
+	if (light.quadratic <= 0.0f)
+		return light.linear > 0.0f ? -c / light.linear : 1.0e4f;
+	return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+// Smallest sphere around the cone, the whole range sphere for wide cones and point lights
+static glm::vec4 lightSphere(const SpotLightData& light, float range)
+{
+	float cosine = light.outerCutOff;
+	if (cosine <= 0.0f)
+		return glm::vec4(light.position, range);
+
+	glm::vec3 axis = glm::normalize(light.direction);
+	float sine = std::sqrt(1.0f - cosine * cosine);
+	if (cosine < 0.70710678f)
+		return glm::vec4(light.position + axis * (cosine * range), sine * range);
+	float radius = range / (2.0f * cosine);
+	return glm::vec4(light.position + axis * radius, radius);
+}
+
+void LightClusters::create()
+{
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glState.bindTexture(CLUSTER_TEXTURE_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	grid.resize(CLUSTER_COUNT * 2);
+	clusterData.tilesX = CLUSTER_TILES_X;
+	clusterData.tilesY = CLUSTER_TILES_Y;
+	clusterData.slices = CLUSTER_SLICES;
+}
+
+void LightClusters::buildClusterBounds(const glm::mat4& projection, float zNear, float zFar)
+{
+	boundsProjection = projection;
+	this->zNear = zNear;
+	this->zFar = zFar;
+	for (std::vector<float>* column : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &centerX, &centerY, &centerZ, &boundsRadius })
+		column->resize(CLUSTER_COUNT);
+
+	// A view space point at depth d (positive) lands on ndc.x = projection[0][0] * x / d
+	for (unsigned int slice = 0; slice < CLUSTER_SLICES; slice++)
+	{
+		float nearDepth = zNear * std::pow(zFar / zNear, (float)slice / CLUSTER_SLICES);
+		float farDepth = zNear * std::pow(zFar / zNear, (float)(slice + 1) / CLUSTER_SLICES);
+		for (unsigned int y = 0; y < CLUSTER_TILES_Y; y++)
+		{
+			float ndcMinY = 2.0f * y / CLUSTER_TILES_Y - 1.0f, ndcMaxY = 2.0f * (y + 1) / CLUSTER_TILES_Y - 1.0f;
+			for (unsigned int x = 0; x < CLUSTER_TILES_X; x++)
+			{
+				float ndcMinX = 2.0f * x / CLUSTER_TILES_X - 1.0f, ndcMaxX = 2.0f * (x + 1) / CLUSTER_TILES_X - 1.0f;
+				unsigned int cluster = x + CLUSTER_TILES_X * (y + CLUSTER_TILES_Y * slice);
+				// The tile widens with depth, the box spans the wider of its two ends
+				minX[cluster] = std::min(ndcMinX * nearDepth, ndcMinX * farDepth) / projection[0][0];
+				maxX[cluster] = std::max(ndcMaxX * nearDepth, ndcMaxX * farDepth) / projection[0][0];
+				minY[cluster] = std::min(ndcMinY * nearDepth, ndcMinY * farDepth) / projection[1][1];
+				maxY[cluster] = std::max(ndcMaxY * nearDepth, ndcMaxY * farDepth) / projection[1][1];
+				minZ[cluster] = -farDepth;
+				maxZ[cluster] = -nearDepth;
+
+				glm::vec3 boxMin(minX[cluster], minY[cluster], minZ[cluster]), boxMax(maxX[cluster], maxY[cluster], maxZ[cluster]);
+				glm::vec3 center = (boxMin + boxMax) * 0.5f;
+				centerX[cluster] = center.x;
+				centerY[cluster] = center.y;
+				centerZ[cluster] = center.z;
+				boundsRadius[cluster] = glm::length(boxMax - center);
+			}
+		}
+	}
+}
+
+void LightClusters::build(const SpotLightData* lights, unsigned int count, const glm::mat4& projection, float zNear, float zFar,
+	int width, int height)
+{
+	if (projection != boundsProjection || zNear != this->zNear || zFar != this->zFar)
+		buildClusterBounds(projection, zNear, zFar);
+
+	lastStats = LightClusterStats();
+	count = std::min(count, MAX_CLUSTERED_LIGHTS);
+	float sliceScale = CLUSTER_SLICES / std::log(zFar / zNear);
+	clusterData.lightCount = count;
+	clusterData.tileScale = glm::vec2((float)CLUSTER_TILES_X / width, (float)CLUSTER_TILES_Y / height);
+	clusterData.sliceScale = sliceScale;
+	clusterData.sliceBias = -std::log(zNear) * sliceScale;
+
+	// BINNING
+	// Only the clusters under the screen rectangle and depth range of the sphere are tested
+	clusterLightPairs.clear();
+	for (unsigned int light = 0; light < count; light++)
+	{
+		const SpotLightData& spot = lights[light];
+		float range = spot.range;
+		glm::vec4 sphere = lightSphere(spot, range);
+		glm::vec3 center(sphere);
+		float radius = sphere.w;
+		// Point lights and cones of 90 degrees or more only use the sphere
+		bool cone = spot.outerCutOff > 0.0f;
+		glm::vec3 axis = cone ? glm::normalize(spot.direction) : glm::vec3(0.0f);
+		float coneSine = std::sqrt(std::max(1.0f - spot.outerCutOff * spot.outerCutOff, 0.0f));
+		float nearDepth = std::max(-center.z - radius, zNear), farDepth = std::min(-center.z + radius, zFar);
+		if (nearDepth > farDepth)
+			continue;
+
+		int firstSlice = (int)(std::log(nearDepth) * sliceScale + clusterData.sliceBias);
+		int lastSlice = (int)(std::log(farDepth) * sliceScale + clusterData.sliceBias);
+		firstSlice = std::max(std::min(firstSlice, (int)CLUSTER_SLICES - 1), 0);
+		lastSlice = std::max(std::min(lastSlice, (int)CLUSTER_SLICES - 1), 0);
+
+		// Projected box of the sphere's box, tiles are in [0, 1] of the screen
+		float tileMin[2], tileMax[2];
+		const float centerXY[2] = { center.x, center.y };
+		for (int dimension = 0; dimension < 2; dimension++)
+		{
+			float scale = projection[dimension][dimension];
+			float low = centerXY[dimension] - radius, high = centerXY[dimension] + radius;
+			float ndcMin = std::min(scale * low / nearDepth, scale * low / farDepth);
+			float ndcMax = std::max(scale * high / nearDepth, scale * high / farDepth);
+			tileMin[dimension] = ndcMin * 0.5f + 0.5f;
+			tileMax[dimension] = ndcMax * 0.5f + 0.5f;
+		}
+		if (tileMax[0] < 0.0f || tileMin[0] > 1.0f || tileMax[1] < 0.0f || tileMin[1] > 1.0f)
+			continue;
+		int firstX = std::max((int)(tileMin[0] * CLUSTER_TILES_X), 0) & ~3;
+		int lastX = std::min((int)(tileMax[0] * CLUSTER_TILES_X), (int)CLUSTER_TILES_X - 1);
+		int firstY = std::max((int)(tileMin[1] * CLUSTER_TILES_Y), 0);
+		int lastY = std::min((int)(tileMax[1] * CLUSTER_TILES_Y), (int)CLUSTER_TILES_Y - 1);
+
+#if defined(CLUSTERS_SSE)
+		__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+		__m128 radiusSquared = _mm_set1_ps(radius * radius);
+		__m128 zero = _mm_setzero_ps();
+		__m128 px = _mm_set1_ps(spot.position.x), py = _mm_set1_ps(spot.position.y), pz = _mm_set1_ps(spot.position.z);
+		__m128 ax = _mm_set1_ps(axis.x), ay = _mm_set1_ps(axis.y), az = _mm_set1_ps(axis.z);
+		__m128 cosine = _mm_set1_ps(spot.outerCutOff), sine = _mm_set1_ps(coneSine), reach = _mm_set1_ps(range);
+#endif
+		for (int slice = firstSlice; slice <= lastSlice; slice++)
+		{
+			for (int y = firstY; y <= lastY; y++)
+			{
+				unsigned int row = CLUSTER_TILES_X * (y + CLUSTER_TILES_Y * slice);
+				for (int x = firstX; x <= lastX; x += 4)
+				{
+					unsigned int cluster = row + x;
+#if defined(CLUSTERS_SSE)
+					// Squared distance from the center to each box, axis by axis
+					__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[cluster]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&maxX[cluster]))), zero);
+					__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[cluster]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&maxY[cluster]))), zero);
+					__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[cluster]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&maxZ[cluster]))), zero);
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int mask = _mm_movemask_ps(_mm_cmple_ps(distance, radiusSquared));
+
+					// Cone against the cluster sphere: the sphere is out when it lies wholly outside the
+					// cone's side, beyond its range or behind its apex
+					if (cone && mask)
+					{
+						__m128 r = _mm_loadu_ps(&boundsRadius[cluster]);
+						__m128 vx = _mm_sub_ps(_mm_loadu_ps(&centerX[cluster]), px);
+						__m128 vy = _mm_sub_ps(_mm_loadu_ps(&centerY[cluster]), py);
+						__m128 vz = _mm_sub_ps(_mm_loadu_ps(&centerZ[cluster]), pz);
+						__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+						__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, ax), _mm_mul_ps(vy, ay)), _mm_mul_ps(vz, az));
+						__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSquared, _mm_mul_ps(along, along)), zero));
+						__m128 sideDistance = _mm_sub_ps(_mm_mul_ps(cosine, across), _mm_mul_ps(sine, along));
+						__m128 inside = _mm_and_ps(_mm_cmple_ps(sideDistance, r),
+							_mm_and_ps(_mm_cmple_ps(along, _mm_add_ps(reach, r)), _mm_cmpge_ps(along, _mm_sub_ps(zero, r))));
+						mask &= _mm_movemask_ps(inside);
+					}
+#else
+					int mask = 0;
+					for (int lane = 0; lane < 4; lane++)
+					{
+						unsigned int c = cluster + lane;
+						float dx = std::max(std::max(minX[c] - center.x, center.x - maxX[c]), 0.0f);
+						float dy = std::max(std::max(minY[c] - center.y, center.y - maxY[c]), 0.0f);
+						float dz = std::max(std::max(minZ[c] - center.z, center.z - maxZ[c]), 0.0f);
+						if (dx * dx + dy * dy + dz * dz > radius * radius)
+							continue;
+						if (cone)
+						{
+							glm::vec3 v = glm::vec3(centerX[c], centerY[c], centerZ[c]) - spot.position;
+							float along = glm::dot(v, axis);
+							float across = std::sqrt(std::max(glm::dot(v, v) - along * along, 0.0f));
+							if (spot.outerCutOff * across - coneSine * along > boundsRadius[c] || along > range + boundsRadius[c] || along < -boundsRadius[c])
+								continue;
+						}
+						mask |= 1 << lane;
+					}
+#endif
+					// Lanes past lastX belong to tiles outside the light's rectangle
+					mask &= (1 << std::min(lastX - x + 1, 4)) - 1;
+					while (mask)
+					{
+						int lane = 0;
+						while (!(mask & (1 << lane)))
+							lane++;
+						clusterLightPairs.push_back(((cluster + lane) << 16) | light);
+						mask &= mask - 1;
+					}
+				}
+			}
+		}
+	}
+
+	// LISTS
+	// Counting sort by cluster, lights stay in order within each list
+	std::fill(grid.begin(), grid.end(), 0);
+	size_t pairCount = clusterLightPairs.size();
+	if (pairCount > MAX_CLUSTER_LIGHT_INDICES)
+	{
+		pairCount = MAX_CLUSTER_LIGHT_INDICES;
+		lastStats.overflow = true;
+		if (!overflowReported)
+		{
+			std::cout << "ERROR::LIGHT_CLUSTERS::TOO_MANY_LIGHT_INDICES" << std::endl;
+			overflowReported = true;
+		}
+	}
+	for (size_t i = 0; i < pairCount; i++)
+		grid[(clusterLightPairs[i] >> 16) * 2 + 1]++;
+	uint32_t offset = 0;
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		uint32_t lightCount = grid[cluster * 2 + 1];
+		grid[cluster * 2] = offset;
+		offset += lightCount;
+		lastStats.occupiedClusters += lightCount > 0 ? 1 : 0;
+		lastStats.maxClusterLights = std::max(lastStats.maxClusterLights, lightCount);
+		grid[cluster * 2 + 1] = 0;
+	}
+	indices.resize(pairCount);
+	for (size_t i = 0; i < pairCount; i++)
+	{
+		uint32_t cluster = clusterLightPairs[i] >> 16;
+		indices[grid[cluster * 2] + grid[cluster * 2 + 1]++] = (uint16_t)(clusterLightPairs[i] & 0xFFFF);
+	}
+	lastStats.lights = count;
+	lastStats.indices = (unsigned int)pairCount;
+
+	upload(buffers[0], lights, count * sizeof(SpotLightData));
+	upload(buffers[1], grid.data(), grid.size() * sizeof(uint32_t));
+	upload(buffers[2], indices.data(), indices.size() * sizeof(uint16_t));
+}
+
+// The old storage is orphaned, draws of earlier frames keep reading it
+void LightClusters::upload(GLuint buffer, const void* data, size_t size)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), NULL, GL_STREAM_DRAW);
+	if (size > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	renderStats.countBufferUpload(size);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::bindTextures() const
+{
+	for (int i = 0; i < 3; i++)
+		glState.bindTexture(CLUSTER_TEXTURE_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+}
@@ -0,0 +1,86 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "framedata.h"
+
+// Cluster grid: screen tiles times depth slices spaced exponentially between the near and far plane
+const unsigned int CLUSTER_TILES_X = 16;
+const unsigned int CLUSTER_TILES_Y = 12;
+const unsigned int CLUSTER_SLICES = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+// Lights one frame can hold, and entries of all cluster light lists together
+const unsigned int MAX_CLUSTERED_LIGHTS = 4096;
+const unsigned int MAX_CLUSTER_LIGHT_INDICES = 256 * 1024;
+// The light, grid and index buffer textures are bound to this unit and the two after it
+const unsigned int CLUSTER_TEXTURE_UNIT = 8;
+
+// Distance at which the attenuated light falls below 1/256 of its brightest color. Kept in
+// SpotLightData::range, which the clusters, the shadow tiles and the light volumes all read.
+float lightRange(const SpotLightData& light);
+
+struct LightClusterStats
+{
+	unsigned int lights = 0;
+	unsigned int indices = 0;               // light list entries of all clusters
+	unsigned int occupiedClusters = 0;      // clusters with at least one light
+	unsigned int maxClusterLights = 0;
+	bool overflow = false;                  // lists were cut at MAX_CLUSTER_LIGHT_INDICES
+};
+
+// Spot lights (point lights have outerCutOff -1) binned into view space clusters on the CPU.
+// A light reaches as far as its attenuation stays above 1/256 of its brightest color. The
+// sphere around its cone is tested against the cluster boxes and the cone itself against the
+// spheres around the boxes, four clusters at a time with SSE. The shader finds its cluster from
+// the pixel and view depth and loops over that cluster's list only, so the cost per pixel depends
+// on the lights nearby, not on the total.
+// Three buffer textures carry the result:
+//   lights   RGBA32F, the SpotLightData of every light (6 texels each)
+//   grid     RG32UI, first list entry and light count of each cluster
+//   indices  R16UI, the concatenated light lists
+class LightClusters
+{
+public:
+	LightClusters() {}
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	void create();
+
+	// Lights are in view space. Cluster boxes are rebuilt when the projection changes.
+	void build(const SpotLightData* lights, unsigned int count, const glm::mat4& projection, float zNear, float zFar,
+		int width, int height);
+
+	void bindTextures() const;
+	// Grid parameters for the ClusterData block of the last build()
+	const ClusterData& data() const { return clusterData; }
+	const LightClusterStats& stats() const { return lastStats; }
+
+private:
+	void buildClusterBounds(const glm::mat4& projection, float zNear, float zFar);
+	void upload(GLuint buffer, const void* data, size_t size);
+
+	// View space boxes of the clusters, x fastest, as columns for the SIMD test
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> centerX, centerY, centerZ, boundsRadius;     // spheres around the boxes
+	glm::mat4 boundsProjection = glm::mat4(0.0f);
+	float zNear = 0.0f;
+	float zFar = 0.0f;
+
+	std::vector<uint32_t> clusterLightPairs;    // cluster and light of each hit, light in the low 16 bits
+	std::vector<uint32_t> grid;                 // offset and count per cluster
+	std::vector<uint16_t> indices;
+
+	GLuint buffers[3] = {};
+	GLuint textures[3] = {};
+	ClusterData clusterData = ClusterData();
+	LightClusterStats lastStats;
+	bool overflowReported = false;
+};
+
+#endif
@@ -4,23 +4,76 @@
 #include "camera.h"
 #include "stb_image.h"
 #include "sphere.h"
+#include "mesh.h"
+#include "instancing.h"
+#include "transform.h"
+#include "material.h"
+#include "entities.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "renderqueue.h"
+#include "meshpool.h"
+#include "indirect.h"
+#include "benchmark.h"
+#include "framedata.h"
+#include "ringbuffer.h"
+#include "staticbatch.h"
+#include "gbuffer.h"
+#include "lightclusters.h"
+#include "shadowatlas.h"
+#include "cascadedshadows.h"
+#include "dynamicresolution.h"
+#include "sky.h"
+#include "profiler.h"
+#include "gpuprofiler.h"
+#include "renderstats.h"
+#include "frametiming.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
-void renderCube();
+void writeFrameTiming();
 
 unsigned int loadTexture(const char* path);
-unsigned int loadCubemap(std::vector<std::string> faces);
+void printBufferStats(const char* name, const BufferAllocatorStats& stats);
+std::vector<SpotLightData> buildLightField();
 
 
 const unsigned int SCREEN_WIDTH = 1600;
 const unsigned int SCREEN_HEIGHT = 1200;
+const float CAMERA_NEAR_PLANE = 0.1f;
+const float CAMERA_FAR_PLANE = 100.0f;
+// Sizes of the shared GPU buffers that meshes and instance matrices are carved out of
+const size_t MESH_POOL_VERTEX_BYTES = 16 * 1024 * 1024;
+const size_t MESH_POOL_INDEX_BYTES = 8 * 1024 * 1024;
+const size_t INSTANCE_STORAGE_BYTES = 4 * 1024 * 1024;
+// Room for the frame, light and draw uniform blocks of one frame in the ring
+const size_t FRAME_RING_BYTES = 64 * 1024;
+// Sides of the cone drawn as the light volume of a spot light
+const unsigned int LIGHT_VOLUME_SEGMENTS = 16;
+// Small colored spotlights over the floor, LIGHT_FIELD_SIDE in each direction
+const unsigned int LIGHT_FIELD_SIDE = 32;
+// Directional light shadow, at most MAX_SHADOW_CASCADES cascades
+const unsigned int SHADOW_CASCADE_COUNT = 4;
+const unsigned int SHADOW_CASCADE_RESOLUTION = 2048;
+const float SHADOW_DISTANCE = 50.0f;
+// GPU time per frame the dynamic resolution aims for, also the budget of the frame time histograms
+const float FRAME_TIME_BUDGET_MS = 1000.0f / 60.0f;
+// Written by key 'J', the trace opens with chrome://tracing or Perfetto
+const char* const PROFILER_TRACE_PATH = "trace.json";
+const char* const GPU_PROFILER_CSV_PATH = "gpu_zones.csv";
+// Scene benchmarks write it, a windowed run adds the average of its render statistics on exit
+const char* const BENCHMARK_CSV_PATH = "benchmark.csv";
+const float RENDER_STATS_PRINT_SECONDS = 5.0f;
+// Written by key 'H' and on exit
+const char* const FRAME_TIMING_CSV_PATH = "frame_timing.csv";
+const char* const FRAME_SPIKES_CSV_PATH = "frame_spikes.csv";
 
 
 glm::vec3 mainPosition = glm::vec3(0.0f, 3.0f, 8.0f);
@@ -36,6 +89,7 @@ Camera* currentCamera = &cameraStatic;
 
 // Light
 glm::vec3 steadyLight = glm::vec3(0.0f, 3.0f, 7.0f);
+glm::vec3 sunDirection = glm::vec3(0.0f, -1.0f, 0.0f);
 float spotLightMovingAngle = 0.0f;
 
 // SkyBox
@@ -57,31 +111,68 @@ std::vector<std::string> facesNight
 	"skyboxes/night/posz.jpg",
 	"skyboxes/night/negz.jpg",
 };
-unsigned int cubemapTexture;
-glm::vec3 dirAmbientLight(0.5f, 0.5f, 0.5f);
+SkyCycle skyCycle;
 
 // Shaders
-Shader* currentShader;
+enum ShadingMode
+{
+	SHADING_PHONG,
+	SHADING_GOURAUD,
+	SHADING_DEFERRED,
+	SHADING_CLUSTERED
+};
+ShadingMode shadingMode = SHADING_PHONG;
 Shader phongShader;
 Shader gourardShader;
 Shader skyboxShader;
-
-// Textures
-unsigned int diffuseMap;
-unsigned int specularMap;
-unsigned int normalMap;
-unsigned int grassTexture;
+Shader depthShader;
+Shader gbufferShader;
+Shader directionalLightShader;
+Shader spotLightShader;
+Shader clusteredShader;
+Shader upscaleShader;
+
+GBuffer gBuffer;
+DynamicResolution dynamicResolution;
+GpuProfiler gpuProfiler;
+FrameTiming frameTiming;
+
+// Lights of the clustered forward path besides the scene's own
+bool lightField = false;
+
+// Depth pre-pass and draw order
+bool depthPrepass = false;
+bool frontToBack = false;
+
+// Materials
+std::vector<Material> materials;
+MaterialHandle grassMaterial;
+MaterialHandle containerMaterial;
+MaterialHandle skyMaterial;
+
+// Meshes
+enum SceneMesh
+{
+	MESH_FLOOR,
+	MESH_CUBE,
+	MESH_SPHERE,
+	MESH_COUNT
+};
+// Part of each mesh's bounds that is solid, sizes the box it hides other objects with (0 = never hides)
+const float meshOccluderScale[MESH_COUNT] = { 0.0f, 1.0f, 0.55f };
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
-bool normalMapping = false;
-
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO, cubeEBO;
+float lastTitleUpdate = 0.0f;
+float lastRenderStatsPrint = 0.0f;
 
-int main()
+int main(int argc, char** argv)
 {
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+		return runBenchmarks(argc > 2 ? argv[2] : BENCHMARK_CSV_PATH);
+
 	// CONFIGURATION
+	setProfilerThreadName("main");
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -103,7 +194,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
-	glEnable(GL_DEPTH_TEST);
+	glState.setEnabled(GL_DEPTH_TEST, true);
 
 
 	// SHADERS
@@ -111,15 +202,81 @@ int main()
 
 	phongShader = Shader("shader.vs", "shader.fs");
 	gourardShader = Shader("gourardShader.vs", "gourardShader.fs");
-	currentShader = &phongShader;
+	depthShader = Shader("depth.vs", "depth.fs");
+	gbufferShader = Shader("gbuffer.vs", "gbuffer.fs");
+	directionalLightShader = Shader("deferredDir.vs", "deferredDir.fs");
+	spotLightShader = Shader("deferredSpot.vs", "deferredSpot.fs");
+	clusteredShader = Shader("clustered.vs", "clustered.fs");
+	upscaleShader = Shader("upscale.vs", "upscale.fs");
+
+	// Per-frame and per-draw values come from uniform blocks, only texture units are uniforms
+	for (Shader* shader : { &phongShader, &gourardShader, &skyboxShader, &depthShader, &gbufferShader, &directionalLightShader, &spotLightShader, &clusteredShader })
+	{
+		shader->setBlockBinding("FrameData", FRAME_DATA_BINDING);
+		shader->setBlockBinding("DrawData", DRAW_DATA_BINDING);
+	}
+	spotLightShader.setBlockBinding("LightData", LIGHT_DATA_BINDING);
+	clusteredShader.setBlockBinding("ClusterData", CLUSTER_DATA_BINDING);
+	for (Shader* shader : { &phongShader, &spotLightShader, &clusteredShader })
+	{
+		shader->setBlockBinding("ShadowData", SHADOW_DATA_BINDING);
+		shader->use();
+		shader->setInt("shadowAtlas", SHADOW_TEXTURE_UNIT);
+	}
+	for (Shader* shader : { &phongShader, &directionalLightShader, &clusteredShader })
+	{
+		shader->setBlockBinding("CascadeData", CASCADE_DATA_BINDING);
+		shader->use();
+		shader->setInt("cascadeMaps", CASCADE_TEXTURE_UNIT);
+	}
+	phongShader.use();
+	phongShader.setInt("material.diffuse", 0);
+	phongShader.setInt("material.specular", 1);
+	phongShader.setInt("material.normal", 1);
+	gourardShader.use();
+	gourardShader.setInt("material.diffuse", 0);
+	gourardShader.setInt("material.specular", 1);
+	gbufferShader.use();
+	gbufferShader.setInt("material.diffuse", 0);
+	gbufferShader.setInt("material.specular", 1);
+	gbufferShader.setInt("material.normal", 1);
+	for (Shader* shader : { &directionalLightShader, &spotLightShader })
+	{
+		shader->use();
+		shader->setInt("gDepth", GBUFFER_TEXTURE_UNIT);
+		shader->setInt("gNormal", GBUFFER_TEXTURE_UNIT + 1);
+		shader->setInt("gAlbedo", GBUFFER_TEXTURE_UNIT + 2);
+	}
+	clusteredShader.use();
+	clusteredShader.setInt("material.diffuse", 0);
+	clusteredShader.setInt("material.specular", 1);
+	clusteredShader.setInt("material.normal", 1);
+	clusteredShader.setInt("clusterLights", CLUSTER_TEXTURE_UNIT);
+	clusteredShader.setInt("clusterGrid", CLUSTER_TEXTURE_UNIT + 1);
+	clusteredShader.setInt("clusterIndices", CLUSTER_TEXTURE_UNIT + 2);
+	upscaleShader.use();
+	upscaleShader.setInt("scene", 0);
 
 
 	// TEXTURES
-	diffuseMap = loadTexture("textures/container2.png");
-	specularMap = loadTexture("textures/container2_specular.png");
-
-	grassTexture = loadTexture("textures/grass.jpg");
-	cubemapTexture = loadCubemap(facesDay);
+	Material container;
+	container.diffuse = loadTexture("textures/container2.png");
+	container.specular = loadTexture("textures/container2_specular.png");
+	containerMaterial = (MaterialHandle)materials.size();
+	materials.push_back(container);
+
+	Material grass;
+	grass.diffuse = loadTexture("textures/grass.jpg");
+	grass.specular = container.specular;
+	grassMaterial = (MaterialHandle)materials.size();
+	materials.push_back(grass);
+
+	// Both skies stay loaded, the night one is decoded in the background
+	skyCycle.create(facesDay, facesNight);
+	Material sky;
+	sky.cubemap = skyCycle.getDayCubemap();
+	skyMaterial = (MaterialHandle)materials.size();
+	materials.push_back(sky);
 
 
 	// DATA
@@ -134,419 +291,414 @@ int main()
 		glm::vec3(1.9f,  4.0f, -1.5f),
 		glm::vec3(-2.9f,  1.5f, -1.5f)
 	};
-	float skyboxVertices[] = {       
-		-1.0f,  1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		-1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f, -1.0f,
-
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		 1.0f, -1.0f,  1.0f
-	};
-	float floorVertices[] = {
-		-20.0f, -0.5f, -20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 10.0f,
-		 20.0f, -0.5f, -20.0f, 0.0f, 1.0f, 0.0f, 10.0f, 10.0f,
-		 20.0f, -0.5f,  20.0f, 0.0f, 1.0f, 0.0f, 10.0f, 0.0f,
-		-20.0f, -0.5f,  20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f
-	};
-	unsigned int floorIndices[] = {
-		0, 1, 2,
-		2, 3, 0
-	};
-
-	// FLOOR
 
-	unsigned int floorVAO, floorVBO, floorEBO;
-	glGenVertexArrays(1, &floorVAO);
-	glGenBuffers(1, &floorVBO);
-	glGenBuffers(1, &floorEBO);
-	glBindVertexArray(floorVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), floorVertices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, floorEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(floorIndices), floorIndices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// FLOOR, CUBES, SPHERE
+	// Built once and cached as binary mesh files, then carved out of the large immutable buffers of the pool
+	if (!loadBufferStorage())
+		std::cout << "Immutable buffer storage is not supported, using glBufferData" << std::endl;
+	MeshPool meshPool;
+	meshPool.create(MESH_POOL_VERTEX_BYTES, MESH_POOL_INDEX_BYTES);
+	// The CPU copies stay loaded, static batches are baked from them
+	std::vector<MeshData> meshData(MESH_COUNT);
+	meshData[MESH_FLOOR] = loadOrBuildMeshData("meshes/floor.gkm", buildFloorMesh);
+	meshData[MESH_CUBE] = loadOrBuildMeshData("meshes/cube.gkm", buildCubeMesh);
+	meshData[MESH_SPHERE] = loadOrBuildMeshData("meshes/sphere_36x18.gkm", []() { return buildSphereMesh(Sphere(1.0f, 36, 18)); });
+	for (const MeshData& data : meshData)
+		meshPool.add(data);
+
+
+	// SCENE
+	// World and normal matrices are cached, only objects that moved are recomputed each frame
+	EntityStore scene;
+	PoolMesh floorMesh = meshPool.get(MESH_FLOOR);
+	PoolMesh cubeMesh = meshPool.get(MESH_CUBE);
+	PoolMesh sphereMesh = meshPool.get(MESH_SPHERE);
+	std::vector<Entity> staticEntities;
+	staticEntities.push_back(scene.create(MESH_FLOOR, grassMaterial, floorMesh.boundsMin, floorMesh.boundsMax));
+	Entity movingCube = scene.create(MESH_CUBE, containerMaterial, cubeMesh.boundsMin, cubeMesh.boundsMax, mainPosition);
+	staticEntities.push_back(scene.create(MESH_SPHERE, containerMaterial, sphereMesh.boundsMin, sphereMesh.boundsMax, glm::vec3(-1.0f, 2.9f, -5.5f)));
+
+	for (unsigned int i = 1; i < 9; i++)
+	{
+		float angle = 20.0f * i;
+		staticEntities.push_back(scene.create(MESH_CUBE, containerMaterial, cubeMesh.boundsMin, cubeMesh.boundsMax,
+			cubePositions[i], glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)))));
+	}
+	// Spatial queries go through the hierarchy, moving objects only refit their path to the root
+	scene.update();
+
+	// Everything but the moving cube is baked into one world space mesh per material and grid cell
+	StaticBatcher staticBatches;
+	for (Entity entity : staticEntities)
+		staticBatches.add(scene, entity);
+	staticBatches.build(scene, meshData, meshPool);
+	Bvh sceneBvh;
+	sceneBvh.build(scene.bounds(), scene.count());
+	OcclusionCuller occlusion;
+	std::vector<Entity> visible;
+
+	// Visible objects are drawn with one multi-draw indirect call per material, copies of a mesh
+	// become instances of one command and matrices are uploaded only when they change
+	if (!loadIndirectDrawing())
+		std::cout << "Multi-draw indirect is not supported, drawing commands one by one" << std::endl;
+	BufferAllocator instanceStorage;
+	instanceStorage.create(INSTANCE_STORAGE_BYTES, sizeof(glm::mat4));
+	IndirectDrawList indirectDraws;
+	indirectDraws.attach(meshPool, &instanceStorage);
+	printBufferStats("Mesh pool vertices", meshPool.vertexStats());
+	printBufferStats("Mesh pool indices", meshPool.indexStats());
+	RenderQueue renderQueue;
+	// GPU time of the frame, the shadow maps and every pass of the queue
+	gpuProfiler.create();
+	renderQueue.setGpuProfiler(&gpuProfiler);
+	// CPU, GPU and present time of every frame, and the zones of the slowest frames
+	frameTiming.setBudget(FRAME_TIME_BUDGET_MS);
+	uint64_t gpuFrameResults = 0;
+	RingBuffer frameRing;
+	frameRing.create(GL_UNIFORM_BUFFER, FRAME_RING_BYTES);
+
+	// DEFERRED SHADING
+	// The G-buffer follows the render size, lights are drawn as a screen covering triangle
+	// (directional) and one cone instance per spot light
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	gBuffer.create(framebufferWidth, framebufferHeight);
+	Mesh lightVolume = uploadMesh(buildConeMesh(LIGHT_VOLUME_SEGMENTS));
+	unsigned int screenTriangleVAO;
+	glGenVertexArrays(1, &screenTriangleVAO);
+
+	// DYNAMIC RESOLUTION
+	// Once enabled the scene is drawn offscreen, smaller while the GPU misses the frame budget
+	dynamicResolution.create(framebufferWidth, framebufferHeight);
+	DynamicResolutionPolicy resolutionPolicy;
+	resolutionPolicy.targetMilliseconds = FRAME_TIME_BUDGET_MS;
+	dynamicResolution.setPolicy(resolutionPolicy);
+
+	// CLUSTERED FORWARD SHADING
+	// Lights are binned on the CPU every frame into the clusters of the view frustum
+	LightClusters lightClusters;
+	lightClusters.create();
+	std::vector<SpotLightData> fieldLights = buildLightField();
+	std::vector<SpotLightData> clusteredLights;
+
+	// SHADOWS
+	// Both scene spot lights own a tile of the atlas, in the order of every light list.
+	// The moving light hangs on the moving cube, which must not shadow it.
+	ShadowAtlas shadowAtlas;
+	shadowAtlas.create(meshPool, &instanceStorage);
+	unsigned int steadyShadow = shadowAtlas.addLight();
+	unsigned int movingShadow = shadowAtlas.addLight(movingCube);
+	// The directional light's cascades follow the camera
+	CascadedShadowMaps cascadedShadows;
+	cascadedShadows.create(meshPool, &instanceStorage, SHADOW_CASCADE_COUNT, SHADOW_CASCADE_RESOLUTION);
+	cascadedShadows.setShadowDistance(SHADOW_DISTANCE);
 
 
 	// SKYBOX
-	unsigned int skyboxVAO, skyboxVBO;
-	glGenVertexArrays(1, &skyboxVAO);
-	glGenBuffers(1, &skyboxVBO);
-	glBindVertexArray(skyboxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	// A screen covering triangle, the ray directions come from the shader
 	skyboxShader.use();
 	skyboxShader.setInt("skybox", 0);
-
-
-	// CUBES
-	renderCube();
-
-
-	// SPHERE
-	Sphere sphere;
-	unsigned int sphereVAO;
-	glGenVertexArrays(1, &sphereVAO);
-	glBindVertexArray(sphereVAO);
-
-	unsigned int vboId;
-	glGenBuffers(1, &vboId);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferData(GL_ARRAY_BUFFER,
-		sphere.getInterleavedVertexSize(),
-		sphere.getInterleavedVertices(),
-		GL_STATIC_DRAW);
-
-	unsigned int iboId;
-	glGenBuffers(1, &iboId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		sphere.getIndexSize(),
-		sphere.getIndices(),
-		GL_STATIC_DRAW);
-
-	int attribVert = 0;
-	int attribNorm = 1;
-	int attribTex = 2;
-	glEnableVertexAttribArray(attribVert);
-	glEnableVertexAttribArray(attribNorm);
-	glEnableVertexAttribArray(attribTex);
-
-	int stride = sphere.getInterleavedStride();
-	glVertexAttribPointer(attribVert, 3, GL_FLOAT, false, stride, (void*)0);
-	glVertexAttribPointer(attribNorm, 3, GL_FLOAT, false, stride, (void*)(sizeof(float) * 3));
-	glVertexAttribPointer(attribTex, 2, GL_FLOAT, false, stride, (void*)(sizeof(float) * 6));
-
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	skyboxShader.setInt("skyboxBlend", 1);
 
 
 	// RENDERING
 	while (!glfwWindowShouldClose(window))
 	{
+		frameTiming.beginFrame();
+		// Before the input, whose key presses load textures
+		renderStats.beginFrame();
+		PROFILE_SCOPE("frame");
 		processInput(window);
 
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Binds the scene target at this frame's render size
+		PROFILE_SECTION("begin frame");
+		gpuProfiler.beginFrame();
+		gpuProfiler.beginZone("frame");
+		dynamicResolution.beginFrame();
+		int renderWidth = dynamicResolution.getRenderWidth(), renderHeight = dynamicResolution.getRenderHeight();
+
+		// The G-buffer only follows the render size while it is used. Recreating it unbinds the
+		// scene target, which the clear below needs.
+		bool deferredShading = shadingMode == SHADING_DEFERRED;
+		if (deferredShading)
+		{
+			gBuffer.resize(renderWidth, renderHeight);
+			glState.bindFramebuffer(GL_FRAMEBUFFER, dynamicResolution.framebuffer());
+		}
 
-		currentShader->use();
+		// Deferred lights add up on black
+		float clearShade = deferredShading ? 0.0f : 0.1f;
+		glClearColor(clearShade, clearShade, clearShade, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+
+		// Sky crossfade, the night sky joins the material once its upload is done
+		skyCycle.update(deltaTime);
+		materials[skyMaterial].cubemapBlend = skyCycle.getNightCubemap();
+		skyboxShader.use();
+		skyboxShader.setFloat("blend", skyCycle.getBlend());
 		
 		// Cameras set up
+		PROFILE_NEXT_SECTION("update scene");
 		glm::vec3 translation = ((float)sin(glfwGetTime()) + 1.0f) * glm::vec3(0.0f, 0.0f, -5.0f);
 		cameraStaticFollowing.Front = glm::normalize(translation - cameraStaticFollowing.Position);
 		cameraTPP.Position = translation - cameraTPP.Front;
 
+		// Update scene
+		scene.transforms.setLocal(movingCube, translation, glm::angleAxis((float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		scene.update();
+		sceneBvh.refit(scene.bounds(), scene.transforms.changed());
+
 		// Set up transformations
-		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
-		currentShader->setMat4("projection", projection);
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
 		glm::mat4 view = currentCamera->GetViewMatrix();
-		currentShader->setMat4("view", view);
-		currentShader->setVec3("viewPos", view * glm::vec4(currentCamera->Position, 1.0));
-
-		// Set up Material
-		currentShader->setInt("material.diffuse", 0);
-		currentShader->setFloat("material.shininess", 32.0f);
-		currentShader->setVec3("fogColor", 0.1f, 0.1f, 0.1f);
-		currentShader->setVec3("cameraPos", currentCamera->Position);
-		currentShader->setVec3("lightPos", view * glm::vec4(steadyLight, 1.0f));
-		currentShader->setBool("normalMapping", false);
-
-		// Set up DirLight
-		currentShader->setVec3("dirLight.direction", glm::normalize(glm::mat3(view)* glm::vec3(0.0f, -1.0f, 0.0f)));
-		currentShader->setVec3("dirLight.ambient", dirAmbientLight);
-		currentShader->setVec3("dirLight.diffuse", 0.5f, 0.5f, 0.5f);
-		currentShader->setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-		// Set up steady spotlight
-		currentShader->setVec3("spotLight.position", view * glm::vec4(steadyLight, 1.0f));
-		currentShader->setVec3("spotLight.direction", glm::normalize(glm::mat3(view) * glm::vec3(0.0f, -3.0f, -7.0f)));
-		currentShader->setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-		currentShader->setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-		currentShader->setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-		currentShader->setFloat("spotLight.constant", 1.0f);
-		currentShader->setFloat("spotLight.linear", 0.09f);
-		currentShader->setFloat("spotLight.quadratic", 0.032f);
-		currentShader->setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		currentShader->setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
+		// Frustum culling, only visible objects are submitted
+		PROFILE_NEXT_SECTION("culling");
+		sceneBvh.queryFrustum(currentCamera->GetFrustum(projection), scene.bounds(), visible);
 
-		// DRAW OBJECTS
-		
-		// Draw floor
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, grassTexture);
-		glBindVertexArray(floorVAO);
-
-		glm::mat4 floorModel = glm::mat4(1.0f);
-		currentShader->setMat4("model", floorModel);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-
-		// Texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuseMap);
-		if (!normalMapping)
+		// Occlusion culling, visible cubes and spheres hide what is entirely behind them
+		occlusion.begin(projection * view);
+		for (Entity entity : visible)
 		{
-			currentShader->setBool("normalMapping", false);
-			currentShader->setInt("material.specular", 1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, specularMap);
+			float occluderScale = meshOccluderScale[scene.mesh[entity]];
+			if (occluderScale <= 0.0f)
+				continue;
+			glm::vec3 extent = scene.localExtent[entity] * occluderScale;
+			occlusion.addOccluder(scene.transforms.world(entity), scene.localCenter[entity] - extent, scene.localCenter[entity] + extent);
 		}
-		else 
+		occlusion.finish();
+		occlusion.cull(scene.bounds(), visible);
+		indirectDraws.setFrontToBack(frontToBack);
+		indirectDraws.build(visible, scene, currentCamera->Position, &staticBatches);
+
+		// Spot lights in world space
+		PROFILE_NEXT_SECTION("shadow maps");
+		SpotLightData steadySpot = SpotLightData();
+		steadySpot.position = steadyLight;
+		steadySpot.direction = glm::normalize(glm::vec3(0.0f, -3.0f, -7.0f));
+		steadySpot.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+		steadySpot.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+		steadySpot.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+		steadySpot.constant = 1.0f;
+		steadySpot.linear = 0.09f;
+		steadySpot.quadratic = 0.032f;
+		steadySpot.cutOff = glm::cos(glm::radians(12.5f));
+		steadySpot.outerCutOff = glm::cos(glm::radians(15.0f));
+		steadySpot.range = lightRange(steadySpot);
+
+		// Light on moving object
+		glm::vec3 normal = glm::vec3(spotLightMovingAngle, -0.3f, 1.0f);
+		SpotLightData movingSpot = steadySpot;
+		movingSpot.position = translation;
+		movingSpot.direction = glm::normalize(scene.transforms.normal(movingCube) * normal);
+		movingSpot.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+		movingSpot.range = lightRange(movingSpot);
+
+		// SHADOW MAPS
+		// Only tiles whose light or casters moved are drawn again, before this frame's ring writes
+		shadowAtlas.setLight(steadyShadow, steadySpot.position, steadySpot.direction, steadySpot.outerCutOff, steadySpot.range);
+		shadowAtlas.setLight(movingShadow, movingSpot.position, movingSpot.direction, movingSpot.outerCutOff, movingSpot.range);
+		gpuProfiler.beginZone("shadow atlas");
+		shadowAtlas.update(scene, sceneBvh, &staticBatches, depthShader);
+		gpuProfiler.endZone();
+		gpuProfiler.beginZone("shadow cascades");
+		cascadedShadows.update(view, projection, sunDirection, scene, sceneBvh, &staticBatches, depthShader);
+		gpuProfiler.endZone();
+
+		// FRAME DATA
+		// Camera, fog and lights for every shader, copied into this frame's region of the ring
+		PROFILE_NEXT_SECTION("frame data");
+		frameRing.beginFrame();
+		FrameData frameData = FrameData();
+		frameData.view = view;
+		frameData.projection = projection;
+		frameData.viewPos = glm::vec3(view * glm::vec4(currentCamera->Position, 1.0));
+		frameData.shininess = 32.0f;
+		frameData.cameraPos = currentCamera->Position;
+		frameData.lightPos = glm::vec3(view * glm::vec4(steadyLight, 1.0f));
+		frameData.fogColor = glm::vec3(0.1f, 0.1f, 0.1f);
+
+		// DirLight
+		frameData.dirLight.direction = glm::normalize(glm::mat3(view) * sunDirection);
+		frameData.dirLight.ambient = skyCycle.getAmbient();
+		frameData.dirLight.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+		frameData.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+
+		// Spot lights, moved to view space
+		frameData.spotLight = steadySpot;
+		frameData.spotLight.position = glm::vec3(view * glm::vec4(steadySpot.position, 1.0f));
+		frameData.spotLight.direction = glm::mat3(view) * steadySpot.direction;
+		frameData.spotLightMoving = movingSpot;
+		frameData.spotLightMoving.position = glm::vec3(view * glm::vec4(movingSpot.position, 1.0f));
+		frameData.spotLightMoving.direction = glm::mat3(view) * movingSpot.direction;
+
+		frameRing.bindRange(FRAME_DATA_BINDING, frameRing.write(frameData), sizeof(FrameData));
+		frameRing.bindRange(SHADOW_DATA_BINDING, frameRing.write(shadowAtlas.data(view)), sizeof(ShadowData));
+		shadowAtlas.bindTexture();
+		frameRing.bindRange(CASCADE_DATA_BINDING, frameRing.write(cascadedShadows.data(view)), sizeof(CascadeData));
+		cascadedShadows.bindTexture();
+
+		// Spot lights of the deferred path
+		unsigned int spotLightCount = 0;
+		if (deferredShading)
 		{
-			currentShader->setBool("normalMapping", true);
-			currentShader->setInt("material.normal", 1);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, normalMap);
+			LightData lightData = LightData();
+			lightData.spotLights[spotLightCount++] = frameData.spotLight;
+			lightData.spotLights[spotLightCount++] = frameData.spotLightMoving;
+			frameRing.bindRange(LIGHT_DATA_BINDING, frameRing.write(lightData), sizeof(LightData));
 		}
 
-		// Draw moving object
-		glBindVertexArray(cubeVAO);
-		glm::mat4 modelFirst = glm::mat4(1.0f);
-	
-		modelFirst = glm::translate(modelFirst, translation);
-		modelFirst = glm::rotate(modelFirst, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		currentShader->setMat4("model", modelFirst);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		// Draw other objects
-		for (unsigned int i = 1; i < 9; i++)
+		// Spot lights of the clustered path, moved to view space and binned
+		if (shadingMode == SHADING_CLUSTERED)
 		{
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			currentShader->setMat4("model", model);
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			clusteredLights.clear();
+			clusteredLights.push_back(frameData.spotLight);
+			clusteredLights.push_back(frameData.spotLightMoving);
+			if (lightField)
+			{
+				for (SpotLightData light : fieldLights)
+				{
+					light.position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+					light.direction = glm::mat3(view) * light.direction;
+					clusteredLights.push_back(light);
+				}
+			}
+			lightClusters.build(clusteredLights.data(), (unsigned int)clusteredLights.size(), projection, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE,
+				renderWidth, renderHeight);
+			lightClusters.bindTextures();
+			frameRing.bindRange(CLUSTER_DATA_BINDING, frameRing.write(lightClusters.data()), sizeof(ClusterData));
 		}
 
-		// Draw sphere
-		glBindVertexArray(sphereVAO);
-
-		glm::mat4 sphereModel = glm::mat4(1.0f);
-		sphereModel = glm::translate(sphereModel, glm::vec3(-1.0f, 2.9f, -5.5f));
-		currentShader->setMat4("model", sphereModel);
 
-		glDrawElements(GL_TRIANGLES,
-			sphere.getIndexCount(),
-			GL_UNSIGNED_INT,
-			(void*)0);
-		glBindVertexArray(0);
+		// DRAW OBJECTS
+		// Draws are sorted by pass, shader, material and mesh, then front to back (or nearest first
+		// when frontToBack is set). The optional pre-pass lays down depth for every command at once,
+		// so the lighting shader then runs only for the visible fragment of each pixel.
+		// Deferred shading fills the G-buffer instead and lights it in screen space.
+		PROFILE_NEXT_SECTION("submit draws");
+		Shader* opaqueShader = &phongShader;
+		if (shadingMode == SHADING_GOURAUD)
+			opaqueShader = &gourardShader;
+		else if (shadingMode == SHADING_DEFERRED)
+			opaqueShader = &gbufferShader;
+		else if (shadingMode == SHADING_CLUSTERED)
+			opaqueShader = &clusteredShader;
+		unsigned int targetFramebuffer = dynamicResolution.framebuffer();
+		unsigned int sceneFramebuffer = deferredShading ? gBuffer.framebuffer() : targetFramebuffer;
+		if (deferredShading)
+			gBuffer.clear();
+		renderQueue.clear();
+		renderQueue.setSortMode(frontToBack ? RENDER_SORT_FRONT_TO_BACK : RENDER_SORT_STATE);
+		renderQueue.setPassFramebuffer(RENDER_PASS_DEPTH, sceneFramebuffer);
+		renderQueue.setPassFramebuffer(RENDER_PASS_OPAQUE, sceneFramebuffer);
+		renderQueue.setPassFramebuffer(RENDER_PASS_LIGHTING, targetFramebuffer);
+		renderQueue.setPassFramebuffer(RENDER_PASS_SKY, targetFramebuffer);
+		if (depthPrepass && indirectDraws.commandCount() > 0)
+		{
+			IndirectBatch everything = { NO_MATERIAL, 0, indirectDraws.commandCount(), 0.0f };
+			renderQueue.submit(RenderCommand::forIndirect(RENDER_PASS_DEPTH, &depthShader, indirectDraws, everything), 0.0f);
+		}
+		for (const IndirectBatch& batch : indirectDraws.batches())
+		{
+			renderQueue.submit(RenderCommand::forIndirect(RENDER_PASS_OPAQUE, opaqueShader, indirectDraws, batch),
+				batch.distance / CAMERA_FAR_PLANE);
+		}
+		if (deferredShading)
+		{
+			gBuffer.bindTextures();
+			renderQueue.submit(RenderCommand::forArrays(RENDER_PASS_LIGHTING, &directionalLightShader, NO_MATERIAL, screenTriangleVAO, 3), 0.0f);
+			renderQueue.submit(RenderCommand::forInstances(RENDER_PASS_LIGHTING, &spotLightShader, NO_MATERIAL, lightVolume, spotLightCount), 0.0f);
+		}
+		renderQueue.submit(RenderCommand::forArrays(RENDER_PASS_SKY, &skyboxShader, skyMaterial, screenTriangleVAO, 3), 1.0f);
+
+		PROFILE_NEXT_SECTION("execute draws");
+		renderQueue.sort();
+		renderQueue.execute(materials, frameRing);
+		gpuProfiler.beginZone("upscale");
+		dynamicResolution.endFrame(upscaleShader, screenTriangleVAO);
+		gpuProfiler.endZone();
+		gpuProfiler.endZone();
+		gpuProfiler.endFrame();
+		const GpuZoneStats* gpuFrame = gpuProfiler.find("frame");
+		if (gpuFrame != nullptr && gpuFrame->results > gpuFrameResults)
+		{
+			frameTiming.addGpuFrame(gpuFrame->last);
+			gpuFrameResults = gpuFrame->results;
+		}
+		frameRing.endFrame();
+		renderStats.endFrame();
 
-		// Light on moving object
-		glm::vec3 normal = glm::vec3(spotLightMovingAngle, -0.3f, 1.0f);
-		glm::vec3 worldNormal = glm::mat3(glm::transpose(glm::inverse(modelFirst))) * normal;
-		glm::vec3 cameraDirection = glm::mat3(view) * worldNormal;
-
-		currentShader->setVec3("spotLightMoving.position", view * glm::vec4(translation, 1.0f));
-		currentShader->setVec3("spotLightMoving.direction", glm::normalize(cameraDirection));
-		currentShader->setVec3("spotLightMoving.ambient", 0.5f, 0.5f, 0.5f);
-		currentShader->setVec3("spotLightMoving.diffuse", 1.0f, 1.0f, 1.0f);
-		currentShader->setVec3("spotLightMoving.specular", 1.0f, 1.0f, 1.0f);
-		currentShader->setFloat("spotLightMoving.constant", 1.0f);
-		currentShader->setFloat("spotLightMoving.linear", 0.09f);
-		currentShader->setFloat("spotLightMoving.quadratic", 0.032f);
-		currentShader->setFloat("spotLightMoving.cutOff", glm::cos(glm::radians(12.5f)));
-		currentShader->setFloat("spotLightMoving.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-		// Draw skybox
-		glDepthFunc(GL_LEQUAL);
-		skyboxShader.use();
-		view = glm::mat4(glm::mat3(currentCamera->GetViewMatrix()));
-		skyboxShader.setMat4("view", view);
-		skyboxShader.setMat4("projection", projection);
+		// Draws, binds and uploads, averaged over the frames since the last print
+		if (currentFrame - lastRenderStatsPrint >= RENDER_STATS_PRINT_SECONDS)
+		{
+			unsigned int frames = 0;
+			RenderCounters period = renderStats.takePeriod(frames);
+			RenderStats::print(period, frames, "Render statistics");
+			lastRenderStatsPrint = currentFrame;
+		}
 
-		glBindVertexArray(skyboxVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LESS);
+		// Fragments shaded by the opaque pass and the ones the pre-pass saved, a few frames late
+		PROFILE_NEXT_SECTION("window title");
+		if (currentFrame - lastTitleUpdate >= 0.5f)
+		{
+			const RenderQueueStats& stats = renderQueue.stats();
+			std::ostringstream title;
+			title << "LearnOpenGL | pre-pass " << (depthPrepass ? "on" : "off") << ", " << (frontToBack ? "front to back" : "state order")
+				<< " | fragments shaded " << stats.samplesPassed[RENDER_PASS_OPAQUE] << ", saved " << stats.fragmentsSaved();
+			if (deferredShading)
+				title << " | deferred, lit " << stats.samplesPassed[RENDER_PASS_LIGHTING];
+			if (shadingMode == SHADING_CLUSTERED)
+			{
+				const LightClusterStats& clusterStats = lightClusters.stats();
+				title << " | clustered, " << clusterStats.lights << " lights, " << clusterStats.indices << " in "
+					<< clusterStats.occupiedClusters << " clusters (max " << clusterStats.maxClusterLights << ")";
+			}
+			const ShadowAtlasStats& shadowStats = shadowAtlas.stats();
+			title << " | shadow tiles drawn " << shadowStats.rendered << ", cached " << shadowStats.cached << " | cascades";
+			for (unsigned int c = 0; c < cascadedShadows.getCascadeCount(); c++)
+			{
+				const CascadeStats& cascadeStats = cascadedShadows.stats(c);
+				title << " " << (cascadeStats.rendered ? "drawn " : "cached ") << cascadeStats.gpuMilliseconds << " ms";
+			}
+			title << " | " << renderWidth << "x" << renderHeight << (dynamicResolution.isEnabled() ? " dynamic" : "")
+				<< ", GPU " << dynamicResolution.getGpuMilliseconds() << " ms";
+			glfwSetWindowTitle(window, title.str().c_str());
+			lastTitleUpdate = currentFrame;
+		}
 
+		PROFILE_NEXT_SECTION("swap buffers");
+		frameTiming.endCpuFrame();
 		glfwSwapBuffers(window);
+		frameTiming.presented();
+		PROFILE_NEXT_SECTION("poll events");
 		glfwPollEvents();
 	}
 
+	writeFrameTiming();
+	BenchmarkReport report(BENCHMARK_CSV_PATH, true);
+	renderStats.report(report, scene.count());
+	if (report.good() && renderStats.frameCount() > 0)
+		std::cout << "Render statistics of " << renderStats.frameCount() << " frames added to " << BENCHMARK_CSV_PATH << std::endl;
+
 	glfwTerminate();
 	return 0;
 }
 
 
 
-void renderCube()
-{
-	float vertices[] = {
-		// positions          // normals           // texture coords
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-	};
-	unsigned int indices[] = {
-		0, 1, 3, 
-		1, 2, 3
-	};
-
-	std::vector<float> cubeVertices;
-	for (int i = 0; i < 36; i += 3)
-	{
-		glm::vec3 pos1(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]);
-		glm::vec3 pos2(vertices[(i + 1) * 8], vertices[(i + 1) * 8 + 1], vertices[(i + 1) * 8 + 2]);
-		glm::vec3 pos3(vertices[(i + 2) * 8], vertices[(i + 2) * 8 + 1], vertices[(i + 2) * 8 + 2]);
-
-		glm::vec2 uv1(vertices[i * 8 + 6], vertices[i * 8 + 7]);
-		glm::vec2 uv2(vertices[(i + 1) * 8 + 6], vertices[(i + 2) * 8 + 7]);
-		glm::vec2 uv3(vertices[(i + 2) * 8 + 6], vertices[(i + 2) * 8 + 7]);
-
-		// calculate tangent/bitangent vectors of triangle
-		glm::vec3 tangent, bitangent;
-
-		glm::vec3 edge1 = pos2 - pos1;
-		glm::vec3 edge2 = pos3 - pos1;
-		glm::vec2 deltaUV1 = uv2 - uv1;
-		glm::vec2 deltaUV2 = uv3 - uv1;
-
-		float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-		tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-		tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-		tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-		bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-		bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-		bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-		// Create new array
-		for (int j = 0; j < 3; j++)
-		{
-			int index = (i + j) * 8;
-			cubeVertices.insert(cubeVertices.end(), {
-				vertices[index], vertices[index + 1], vertices[index + 2],
-				vertices[index + 3], vertices[index + 4], vertices[index + 5],
-				vertices[index + 6], vertices[index + 7],
-				tangent.x, tangent.y, tangent.z,
-				bitangent.x, bitangent.y, bitangent.z
-			});
-		}
-	}
-
-	// configure plane VAO
-	glGenVertexArrays(1, &cubeVAO);
-	glGenBuffers(1, &cubeVBO);
-	glGenBuffers(1, &cubeEBO);
-
-	glBindVertexArray(cubeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
-	glBufferData(GL_ARRAY_BUFFER, cubeVertices.size() * sizeof(float), cubeVertices.data(), GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(8 * sizeof(float)));
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
-}
-
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	dynamicResolution.resize(width, height);
 }
 
 void processInput(GLFWwindow* window)
 {
+	PROFILE_FUNCTION();
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
@@ -560,15 +712,9 @@ void processInput(GLFWwindow* window)
 
 	// Day/Night
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-	{
-		dirAmbientLight = glm::vec3(0.5f, 0.5f, 0.5f);
-		cubemapTexture = loadCubemap(facesDay);
-	}
+		skyCycle.setNight(false);
 	if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
-	{
-		dirAmbientLight = glm::vec3(0.1f, 0.1f, 0.1f);
-		cubemapTexture = loadCubemap(facesNight);
-	}
+		skyCycle.setNight(true);
 
 	// Moving spotlight
 	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
@@ -582,33 +728,96 @@ void processInput(GLFWwindow* window)
 			spotLightMovingAngle -= 0.01f;
 	}
 
-	// Phong/Gourard
+	// Phong/Gourard/Deferred/Clustered
 	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
 	{	
-		currentShader = &gourardShader;
+		shadingMode = SHADING_GOURAUD;
 	}
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
 	{
-		currentShader = &phongShader;
+		shadingMode = SHADING_PHONG;
 	}
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+		shadingMode = SHADING_DEFERRED;
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+		shadingMode = SHADING_CLUSTERED;
+
+	// Light field of the clustered path
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
+		lightField = true;
+	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
+		lightField = false;
+
+	// Depth pre-pass
+	if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+		depthPrepass = true;
+	if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
+		depthPrepass = false;
+
+	// Dynamic resolution
+	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+		dynamicResolution.setEnabled(true);
+	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+		dynamicResolution.setEnabled(false);
+
+	// Draw order
+	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+		frontToBack = true;
+	if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS)
+		frontToBack = false;
 
 	// Normal mapping
 	if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS)
 	{
-		diffuseMap = loadTexture("textures/brickwall.jpg");
-		normalMap = loadTexture("textures/brickwall_normal.jpg");
-		normalMapping = true;
+		Material& container = materials[containerMaterial];
+		container.diffuse = loadTexture("textures/brickwall.jpg");
+		container.normal = loadTexture("textures/brickwall_normal.jpg");
+		container.normalMapping = true;
 	}
 	if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS)
 	{
-		diffuseMap = loadTexture("textures/container2.png");
-		specularMap = loadTexture("textures/container2_specular.png");
-		normalMapping = false;
+		Material& container = materials[containerMaterial];
+		container.diffuse = loadTexture("textures/container2.png");
+		container.specular = loadTexture("textures/container2_specular.png");
+		container.normalMapping = false;
 	}
+
+	// CPU and GPU trace and GPU zone statistics, written once per press
+	static bool traceKeyDown = false;
+	bool traceKey = glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS;
+	if (traceKey && !traceKeyDown)
+	{
+		size_t events = writeProfilerTrace(PROFILER_TRACE_PATH);
+		if (events > 0)
+			std::cout << "CPU trace of " << events << " events written to " << PROFILER_TRACE_PATH << std::endl;
+		else
+			std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << PROFILER_TRACE_PATH << std::endl;
+		gpuProfiler.print();
+		if (!gpuProfiler.writeCsv(GPU_PROFILER_CSV_PATH))
+			std::cout << "ERROR::GPU_PROFILER::CSV_NOT_WRITTEN " << GPU_PROFILER_CSV_PATH << std::endl;
+	}
+	traceKeyDown = traceKey;
+
+	// Frame time percentiles and spikes so far, written once per press
+	static bool timingKeyDown = false;
+	bool timingKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+	if (timingKey && !timingKeyDown)
+		writeFrameTiming();
+	timingKeyDown = timingKey;
+}
+
+void writeFrameTiming()
+{
+	frameTiming.print();
+	if (frameTiming.writeCsv(FRAME_TIMING_CSV_PATH, FRAME_SPIKES_CSV_PATH))
+		std::cout << "Frame times written to " << FRAME_TIMING_CSV_PATH << " and " << FRAME_SPIKES_CSV_PATH << std::endl;
+	else
+		std::cout << "ERROR::FRAME_TIMING::CSV_NOT_WRITTEN " << FRAME_TIMING_CSV_PATH << std::endl;
 }
 
 unsigned int loadTexture(const char* path)
 {
+	PROFILE_SCOPE_DETAIL("loadTexture", path);
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 
@@ -623,8 +832,9 @@ unsigned int loadTexture(const char* path)
 		else if (nrComponents == 4)
 			format = GL_RGBA;
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		glState.bindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		renderStats.countTextureUpload((size_t)width * height * nrComponents);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -643,32 +853,40 @@ unsigned int loadTexture(const char* path)
 	return textureID;
 }
 
-unsigned int loadCubemap(std::vector<std::string> faces)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-	int width, height, nrChannels;
-	for (unsigned int i = 0; i < faces.size(); i++)
+
+// World space spotlights half a meter above the floor pointing down, colors going around the hue circle
+std::vector<SpotLightData> buildLightField()
+{
+	std::vector<SpotLightData> lights;
+	for (unsigned int z = 0; z < LIGHT_FIELD_SIDE; z++)
 	{
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
+		for (unsigned int x = 0; x < LIGHT_FIELD_SIDE; x++)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
+			float hue = 6.0f * (x + z * LIGHT_FIELD_SIDE) / (LIGHT_FIELD_SIDE * LIGHT_FIELD_SIDE);
+			glm::vec3 color = glm::clamp(glm::vec3(fabs(hue - 3.0f) - 1.0f, 2.0f - fabs(hue - 2.0f), 2.0f - fabs(hue - 4.0f)), 0.0f, 1.0f);
+
+			SpotLightData light = SpotLightData();
+			light.position = glm::vec3(-19.0f + 38.0f * (x + 0.5f) / LIGHT_FIELD_SIDE, 0.0f, -19.0f + 38.0f * (z + 0.5f) / LIGHT_FIELD_SIDE);
+			light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+			light.ambient = glm::vec3(0.0f);
+			light.diffuse = color * 4.0f;
+			light.specular = color;
+			light.constant = 1.0f;
+			light.linear = 0.0f;
+			light.quadratic = 4.0f;
+			light.cutOff = glm::cos(glm::radians(35.0f));
+			light.outerCutOff = glm::cos(glm::radians(45.0f));
+			light.range = lightRange(light);
+			lights.push_back(light);
 		}
 	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	return lights;
+}
 
-	return textureID;
+void printBufferStats(const char* name, const BufferAllocatorStats& stats)
+{
+	std::cout << name << ": " << stats.used / 1024 << " of " << stats.capacity / 1024 << " KB used ("
+		<< stats.utilization() * 100.0f << "%), " << stats.allocations << " allocations, "
+		<< stats.freeBlocks << " free blocks, fragmentation " << stats.fragmentation() << std::endl;
 }
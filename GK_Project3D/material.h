@@ -0,0 +1,38 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include "glstate.h"
+
+typedef unsigned int MaterialHandle;
+
+const MaterialHandle NO_MATERIAL = 0xFFFFFFFF;
+
+// Texture set of an object. Diffuse goes to unit 0, specular (or the normal map when
+// normal mapping is on) to unit 1. A cube map material (the sky) only binds its cube map to unit 0
+// and the one it blends towards to unit 1.
+// The normal mapping flag reaches the shader through the per-draw data of the render queue.
+struct Material
+{
+	unsigned int diffuse = 0;
+	unsigned int specular = 0;
+	unsigned int normal = 0;
+	unsigned int cubemap = 0;
+	unsigned int cubemapBlend = 0;
+	bool normalMapping = false;
+
+	void bind() const
+	{
+		if (cubemap != 0)
+		{
+			glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap);
+			glState.bindTexture(1, GL_TEXTURE_CUBE_MAP, cubemapBlend);
+			return;
+		}
+		glState.bindTexture(0, GL_TEXTURE_2D, diffuse);
+		glState.bindTexture(1, GL_TEXTURE_2D, normalMapping ? normal : specular);
+	}
+};
+
+#endif
@@ -0,0 +1,577 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mesh.h"
+#include "Sphere.h"
+#include "profiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+static_assert(sizeof(MeshFileHeader) % MESH_FILE_ALIGNMENT == 0, "mesh file header must keep the data blocks aligned");
+
+
+// MAPPED FILE
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	bytes = (const unsigned char*)view;
+	length = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	bytes = (const unsigned char*)view;
+	length = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(bytes);
+	CloseHandle((HANDLE)mappingHandle);
+	CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap((void*)bytes, length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
+
+
+// LAYOUTS
+
+VertexLayout layoutPosition()
+{
+	VertexLayout layout = {};
+	layout.stride = 3 * sizeof(float);
+	layout.attributeCount = 1;
+	layout.attributes[0] = { 0, 3, GL_FLOAT, GL_FALSE, 0 };
+	return layout;
+}
+
+VertexLayout layoutPositionNormalTex()
+{
+	VertexLayout layout = {};
+	layout.stride = 8 * sizeof(float);
+	layout.attributeCount = 3;
+	layout.attributes[0] = { 0, 3, GL_FLOAT, GL_FALSE, 0 };
+	layout.attributes[1] = { 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float) };
+	layout.attributes[2] = { 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float) };
+	return layout;
+}
+
+VertexLayout layoutPositionNormalTexTangent()
+{
+	VertexLayout layout = layoutPositionNormalTex();
+	layout.stride = 14 * sizeof(float);
+	layout.attributeCount = 5;
+	layout.attributes[3] = { 3, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float) };
+	layout.attributes[4] = { 4, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float) };
+	return layout;
+}
+
+void MeshData::computeBounds()
+{
+	// Position is always the first three floats of a vertex
+	const unsigned int floatStride = layout.stride / sizeof(float);
+	boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i + 2 < vertices.size(); i += floatStride)
+	{
+		glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+}
+
+MeshData convertLayout(const MeshData& data, const VertexLayout& layout)
+{
+	// Copy attribute by attribute location, attributes the source does not have stay zero
+	const unsigned int vertexCount = data.vertexCount();
+	const unsigned int floatStride = layout.stride / sizeof(float);
+	const unsigned char* source = (const unsigned char*)data.vertices.data();
+	MeshData converted;
+	converted.layout = layout;
+	converted.vertices.assign((size_t)vertexCount * floatStride, 0.0f);
+	converted.indices = data.indices;
+	converted.boundsMin = data.boundsMin;
+	converted.boundsMax = data.boundsMax;
+
+	for (unsigned int a = 0; a < layout.attributeCount; a++)
+	{
+		const VertexAttribute& target = layout.attributes[a];
+		for (unsigned int b = 0; b < data.layout.attributeCount; b++)
+		{
+			const VertexAttribute& attribute = data.layout.attributes[b];
+			if (attribute.location != target.location)
+				continue;
+			if (attribute.type != GL_FLOAT)
+			{
+				std::cout << "ERROR::MESH::UNSUPPORTED_ATTRIBUTE_TYPE " << attribute.location << std::endl;
+				break;
+			}
+
+			size_t bytes = std::min(attribute.components, target.components) * sizeof(float);
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				memcpy(&converted.vertices[(size_t)v * floatStride + target.offset / sizeof(float)],
+					source + (size_t)v * data.layout.stride + attribute.offset, bytes);
+			}
+			break;
+		}
+	}
+	return converted;
+}
+
+
+// UPLOAD
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static Mesh createMesh(const VertexLayout& layout, const void* vertices, size_t vertexBytes,
+	const void* indices, size_t indexBytes, unsigned int indexCount, GLenum indexType)
+{
+	Mesh mesh;
+	mesh.indexCount = indexCount;
+	mesh.indexType = indexType;
+
+	glGenVertexArrays(1, &mesh.VAO);
+	glGenBuffers(1, &mesh.VBO);
+	glGenBuffers(1, &mesh.EBO);
+
+	glState.bindVertexArray(mesh.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+	renderStats.countBufferUpload(vertexBytes + indexBytes);
+
+	for (unsigned int i = 0; i < layout.attributeCount; i++)
+	{
+		const VertexAttribute& attribute = layout.attributes[i];
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+			attribute.normalized ? GL_TRUE : GL_FALSE, layout.stride, (void*)(size_t)attribute.offset);
+	}
+
+	glState.bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return mesh;
+}
+
+Mesh uploadMesh(const MeshData& data)
+{
+	Mesh mesh = createMesh(data.layout, data.vertices.data(), data.vertices.size() * sizeof(float),
+		data.indices.data(), data.indices.size() * sizeof(unsigned int), (unsigned int)data.indices.size(), GL_UNSIGNED_INT);
+	mesh.boundsMin = data.boundsMin;
+	mesh.boundsMax = data.boundsMax;
+	return mesh;
+}
+
+
+// FILES
+
+// Bytes of one component of an attribute type, 0 for types mesh files do not use
+static unsigned int attributeTypeSize(uint32_t type)
+{
+	switch (type)
+	{
+	case GL_FLOAT:
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+		return 4;
+	case GL_HALF_FLOAT:
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+		return 2;
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static bool validHeader(const MeshFileHeader& header, size_t fileSize)
+{
+	if (memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0)
+		return false;
+	if (header.version != MESH_FILE_VERSION || header.headerSize != sizeof(MeshFileHeader))
+		return false;
+	if (header.indexType != GL_UNSIGNED_SHORT && header.indexType != GL_UNSIGNED_INT)
+		return false;
+	if (header.layout.attributeCount > MAX_VERTEX_ATTRIBUTES || header.layout.stride == 0)
+		return false;
+	// Every attribute must lie inside its vertex, or the attribute pointers read past it
+	for (uint32_t i = 0; i < header.layout.attributeCount; i++)
+	{
+		const VertexAttribute& attribute = header.layout.attributes[i];
+		unsigned int typeSize = attributeTypeSize(attribute.type);
+		if (typeSize == 0 || attribute.components == 0 || attribute.components > 4)
+			return false;
+		if ((uint64_t)attribute.offset + (uint64_t)attribute.components * typeSize > header.layout.stride)
+			return false;
+	}
+	if (header.vertexBytes != (uint64_t)header.vertexCount * header.layout.stride)
+		return false;
+	if (header.indexBytes != (uint64_t)header.indexCount * (header.indexType == GL_UNSIGNED_SHORT ? 2 : 4))
+		return false;
+	if (header.vertexOffset > fileSize || header.vertexBytes > fileSize - header.vertexOffset)
+		return false;
+	if (header.indexOffset > fileSize || header.indexBytes > fileSize - header.indexOffset)
+		return false;
+	return true;
+}
+
+static bool ensureDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	if (slash == std::string::npos)
+		return true;
+	std::string directory = path.substr(0, slash);
+#ifdef _WIN32
+	return _mkdir(directory.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool saveMesh(const std::string& path, const MeshData& mesh)
+{
+	const unsigned int vertexCount = mesh.vertexCount();
+	const bool shortIndices = vertexCount <= std::numeric_limits<unsigned short>::max() + 1u;
+
+	MeshFileHeader header = {};
+	memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+	header.version = MESH_FILE_VERSION;
+	header.headerSize = sizeof(MeshFileHeader);
+	header.indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	header.vertexCount = vertexCount;
+	header.indexCount = (uint32_t)mesh.indices.size();
+	header.vertexOffset = sizeof(MeshFileHeader);
+	header.vertexBytes = (uint64_t)vertexCount * mesh.layout.stride;
+	header.indexOffset = alignUp((size_t)(header.vertexOffset + header.vertexBytes), MESH_FILE_ALIGNMENT);
+	header.indexBytes = (uint64_t)header.indexCount * (shortIndices ? 2 : 4);
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = mesh.boundsMin[i];
+		header.boundsMax[i] = mesh.boundsMax[i];
+	}
+	header.layout = mesh.layout;
+
+	ensureDirectory(path);
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+	{
+		std::cout << "Mesh file failed to save at path: " << path << std::endl;
+		return false;
+	}
+
+	static const unsigned char padding[MESH_FILE_ALIGNMENT] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(mesh.vertices.data(), 1, (size_t)header.vertexBytes, file) == header.vertexBytes;
+	size_t paddingBytes = (size_t)(header.indexOffset - header.vertexOffset - header.vertexBytes);
+	ok = ok && fwrite(padding, 1, paddingBytes, file) == paddingBytes;
+	if (shortIndices)
+	{
+		std::vector<unsigned short> shortIndexData(mesh.indices.begin(), mesh.indices.end());
+		ok = ok && fwrite(shortIndexData.data(), 1, (size_t)header.indexBytes, file) == header.indexBytes;
+	}
+	else
+	{
+		ok = ok && fwrite(mesh.indices.data(), 1, (size_t)header.indexBytes, file) == header.indexBytes;
+	}
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+	{
+		std::cout << "Mesh file failed to save at path: " << path << std::endl;
+		remove(path.c_str());
+	}
+	return ok;
+}
+
+bool loadMeshData(const std::string& path, MeshData& mesh)
+{
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+
+	MeshFileHeader header;
+	if (file.size() < sizeof(header))
+		return false;
+	memcpy(&header, file.data(), sizeof(header));
+	if (!validHeader(header, file.size()) || header.layout.stride % sizeof(float) != 0)
+	{
+		std::cout << "Mesh file is outdated or corrupted at path: " << path << std::endl;
+		return false;
+	}
+
+	mesh.layout = header.layout;
+	mesh.vertices.resize((size_t)(header.vertexBytes / sizeof(float)));
+	memcpy(mesh.vertices.data(), file.data() + header.vertexOffset, (size_t)header.vertexBytes);
+	mesh.indices.resize(header.indexCount);
+	if (header.indexType == GL_UNSIGNED_SHORT)
+	{
+		const unsigned char* shortIndices = file.data() + header.indexOffset;
+		for (unsigned int i = 0; i < header.indexCount; i++)
+		{
+			unsigned short index;
+			memcpy(&index, shortIndices + i * sizeof(index), sizeof(index));
+			mesh.indices[i] = index;
+		}
+	}
+	else
+	{
+		memcpy(mesh.indices.data(), file.data() + header.indexOffset, (size_t)header.indexBytes);
+	}
+	// An index past the vertices would read another mesh of the pool, or past its end
+	for (unsigned int index : mesh.indices)
+	{
+		if (index >= header.vertexCount)
+		{
+			std::cout << "Mesh file is outdated or corrupted at path: " << path << std::endl;
+			return false;
+		}
+	}
+	mesh.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	mesh.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+MeshData loadOrBuildMeshData(const std::string& path, const std::function<MeshData()>& build)
+{
+	PROFILE_SCOPE_DETAIL("loadOrBuildMeshData", path.c_str());
+	MeshData mesh;
+	if (loadMeshData(path, mesh))
+		return mesh;
+
+	mesh = build();
+	saveMesh(path, mesh);
+	return mesh;
+}
+
+
+// BUILDERS
+
+MeshData buildCubeMesh()
+{
+	float vertices[] = {
+		// positions          // normals           // texture coords
+		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+
+		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+
+		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+
+		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
+		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+
+		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
+		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
+		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
+	};
+
+	MeshData mesh;
+	mesh.layout = layoutPositionNormalTexTangent();
+	for (int i = 0; i < 36; i += 3)
+	{
+		glm::vec3 pos1(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]);
+		glm::vec3 pos2(vertices[(i + 1) * 8], vertices[(i + 1) * 8 + 1], vertices[(i + 1) * 8 + 2]);
+		glm::vec3 pos3(vertices[(i + 2) * 8], vertices[(i + 2) * 8 + 1], vertices[(i + 2) * 8 + 2]);
+
+		glm::vec2 uv1(vertices[i * 8 + 6], vertices[i * 8 + 7]);
+		glm::vec2 uv2(vertices[(i + 1) * 8 + 6], vertices[(i + 2) * 8 + 7]);
+		glm::vec2 uv3(vertices[(i + 2) * 8 + 6], vertices[(i + 2) * 8 + 7]);
+
+		// calculate tangent/bitangent vectors of triangle
+		glm::vec3 tangent, bitangent;
+
+		glm::vec3 edge1 = pos2 - pos1;
+		glm::vec3 edge2 = pos3 - pos1;
+		glm::vec2 deltaUV1 = uv2 - uv1;
+		glm::vec2 deltaUV2 = uv3 - uv1;
+
+		float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+		tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+		tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+		tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+
+		bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+		bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+		bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+
+		for (int j = 0; j < 3; j++)
+		{
+			int index = (i + j) * 8;
+			mesh.vertices.insert(mesh.vertices.end(), {
+				vertices[index], vertices[index + 1], vertices[index + 2],
+				vertices[index + 3], vertices[index + 4], vertices[index + 5],
+				vertices[index + 6], vertices[index + 7],
+				tangent.x, tangent.y, tangent.z,
+				bitangent.x, bitangent.y, bitangent.z
+			});
+			mesh.indices.push_back(i + j);
+		}
+	}
+	mesh.computeBounds();
+	return mesh;
+}
+
+MeshData buildFloorMesh()
+{
+	MeshData mesh;
+	mesh.layout = layoutPositionNormalTex();
+	mesh.vertices = {
+		-20.0f, -0.5f, -20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 10.0f,
+		 20.0f, -0.5f, -20.0f, 0.0f, 1.0f, 0.0f, 10.0f, 10.0f,
+		 20.0f, -0.5f,  20.0f, 0.0f, 1.0f, 0.0f, 10.0f, 0.0f,
+		-20.0f, -0.5f,  20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f
+	};
+	mesh.indices = {
+		0, 1, 2,
+		2, 3, 0
+	};
+	mesh.computeBounds();
+	return mesh;
+}
+
+MeshData buildSphereMesh(const Sphere& sphere)
+{
+	MeshData mesh;
+	mesh.layout = layoutPositionNormalTex();
+	mesh.layout.stride = sphere.getInterleavedStride();
+	const float* vertices = sphere.getInterleavedVertices();
+	mesh.vertices.assign(vertices, vertices + sphere.getInterleavedVertexSize() / sizeof(float));
+	mesh.indices.assign(sphere.getIndices(), sphere.getIndices() + sphere.getIndexCount());
+	mesh.computeBounds();
+	return mesh;
+}
+
+MeshData buildConeMesh(unsigned int segments)
+{
+	MeshData mesh;
+	mesh.layout = layoutPosition();
+
+	// Apex first, then the base ring. The ring is pushed out so that its flat sides
+	// still enclose the unit circle.
+	const float radius = 1.0f / cosf(glm::pi<float>() / segments);
+	mesh.vertices = { 0.0f, 0.0f, 0.0f };
+	for (unsigned int i = 0; i < segments; i++)
+	{
+		float angle = 2.0f * glm::pi<float>() * i / segments;
+		mesh.vertices.insert(mesh.vertices.end(), { radius * cosf(angle), radius * sinf(angle), -1.0f });
+	}
+	unsigned int center = segments + 1;
+	mesh.vertices.insert(mesh.vertices.end(), { 0.0f, 0.0f, -1.0f });
+
+	// Counter-clockwise seen from outside
+	for (unsigned int i = 0; i < segments; i++)
+	{
+		unsigned int current = 1 + i, next = 1 + (i + 1) % segments;
+		mesh.indices.insert(mesh.indices.end(), { 0, current, next });
+		mesh.indices.insert(mesh.indices.end(), { center, next, current });
+	}
+	mesh.computeBounds();
+	return mesh;
+}
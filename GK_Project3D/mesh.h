@@ -0,0 +1,138 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "glstate.h"
+#include "renderstats.h"
+
+class Sphere;
+
+// Binary mesh file (*.gkm)
+// Little endian. The header is followed by the vertex block and the index block,
+// each aligned to MESH_FILE_ALIGNMENT so both can be copied straight out of a mapped view.
+const char MESH_FILE_MAGIC[4] = { 'G', 'K', 'M', 'S' };
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_FILE_ALIGNMENT = 16;
+const int MAX_VERTEX_ATTRIBUTES = 8;
+
+struct VertexAttribute
+{
+	uint32_t location;
+	uint32_t components;
+	uint32_t type;          // GL_FLOAT, GL_UNSIGNED_BYTE, ...
+	uint32_t normalized;
+	uint32_t offset;        // bytes from the start of a vertex
+};
+
+struct VertexLayout
+{
+	uint32_t stride;        // bytes per vertex
+	uint32_t attributeCount;
+	VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+};
+
+struct MeshFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t vertexBytes;
+	uint64_t indexOffset;
+	uint64_t indexBytes;
+	float boundsMin[3];
+	float boundsMax[3];
+	VertexLayout layout;
+	uint32_t reserved[2];   // keeps the header size a multiple of MESH_FILE_ALIGNMENT
+};
+
+// Mesh kept in memory, e.g. built procedurally before it is written to a file
+struct MeshData
+{
+	VertexLayout layout;
+	std::vector<float> vertices;            // interleaved, layout.stride bytes per vertex
+	std::vector<unsigned int> indices;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	unsigned int vertexCount() const { return (unsigned int)(vertices.size() * sizeof(float) / layout.stride); }
+	void computeBounds();
+};
+
+// Mesh uploaded to the GPU
+struct Mesh
+{
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+	unsigned int EBO = 0;
+	unsigned int indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	void draw() const
+	{
+		glState.bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)0);
+		renderStats.countDraw(GL_TRIANGLES, indexCount);
+	}
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+// Layout of position only vertices used by light volumes
+VertexLayout layoutPosition();
+// Layout of 'position, normal, texture coords' vertices used by the floor and the sphere
+VertexLayout layoutPositionNormalTex();
+// Layout of 'position, normal, texture coords, tangent, bitangent' vertices used by the cubes
+VertexLayout layoutPositionNormalTexTangent();
+
+bool saveMesh(const std::string& path, const MeshData& mesh);
+// Reads the file into memory, e.g. to pack it with other meshes
+bool loadMeshData(const std::string& path, MeshData& mesh);
+Mesh uploadMesh(const MeshData& mesh);
+// Copy of the mesh with float attributes moved to the places of layout, missing attributes are zero
+MeshData convertLayout(const MeshData& data, const VertexLayout& layout);
+// Loads the mesh from path, or builds it and writes it to path for the next start
+MeshData loadOrBuildMeshData(const std::string& path, const std::function<MeshData()>& build);
+
+MeshData buildCubeMesh();
+MeshData buildFloorMesh();
+MeshData buildSphereMesh(const Sphere& sphere);
+// Cone with its apex at the origin opening along -Z, the base of radius 1 lies at z = -1
+MeshData buildConeMesh(unsigned int segments);
+
+#endif
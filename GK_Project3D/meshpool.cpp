@@ -0,0 +1,108 @@
+#include "meshpool.h"
+
+#include <iostream>
+
+#include "glstate.h"
+
+void MeshPool::create(size_t vertexBytes, size_t indexBytes)
+{
+	// Vertex ranges start on whole vertices so that baseVertex is exact
+	vertexStorage.create(vertexBytes, vertexLayout.stride);
+	indexStorage.create(indexBytes, sizeof(unsigned int));
+	meshes.clear();
+	freeHandles.clear();
+
+	if (VAO == 0)
+		glGenVertexArrays(1, &VAO);
+	setupVertexArray(VAO);
+}
+
+unsigned int MeshPool::createVertexArray() const
+{
+	unsigned int vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	setupVertexArray(vertexArray);
+	return vertexArray;
+}
+
+void MeshPool::setupVertexArray(unsigned int vertexArray) const
+{
+	glState.bindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexStorage.buffer());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexStorage.buffer());
+	for (unsigned int i = 0; i < vertexLayout.attributeCount; i++)
+	{
+		const VertexAttribute& attribute = vertexLayout.attributes[i];
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+			attribute.normalized ? GL_TRUE : GL_FALSE, vertexLayout.stride, (void*)(size_t)attribute.offset);
+	}
+
+	glState.bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+MeshHandle MeshPool::add(const MeshData& data)
+{
+	// Every vertex is repacked into the pool layout
+	MeshData converted = convertLayout(data, vertexLayout);
+	const std::vector<float>& vertices = converted.vertices;
+
+	Entry entry;
+	entry.indexCount = (unsigned int)data.indices.size();
+	entry.boundsMin = data.boundsMin;
+	entry.boundsMax = data.boundsMax;
+	entry.vertices = vertexStorage.allocate(vertices.size() * sizeof(float));
+	entry.indices = indexStorage.allocate(data.indices.size() * sizeof(unsigned int));
+	if (entry.vertices == NO_ALLOCATION || entry.indices == NO_ALLOCATION)
+	{
+		std::cout << "ERROR::MESH_POOL::OUT_OF_MEMORY" << std::endl;
+		vertexStorage.free(entry.vertices);
+		indexStorage.free(entry.indices);
+		return NO_POOL_MESH;
+	}
+	vertexStorage.write(entry.vertices, 0, vertices.size() * sizeof(float), vertices.data());
+	indexStorage.write(entry.indices, 0, data.indices.size() * sizeof(unsigned int), data.indices.data());
+
+	if (!freeHandles.empty())
+	{
+		MeshHandle mesh = freeHandles.back();
+		freeHandles.pop_back();
+		meshes[mesh] = entry;
+		return mesh;
+	}
+	meshes.push_back(entry);
+	return (MeshHandle)(meshes.size() - 1);
+}
+
+void MeshPool::remove(MeshHandle mesh)
+{
+	Entry& entry = meshes[mesh];
+	if (entry.vertices == NO_ALLOCATION)
+		return;
+	vertexStorage.free(entry.vertices);
+	indexStorage.free(entry.indices);
+	entry = Entry();
+	freeHandles.push_back(mesh);
+}
+
+void MeshPool::defragment()
+{
+	vertexStorage.defragment();
+	indexStorage.defragment();
+}
+
+PoolMesh MeshPool::get(MeshHandle mesh) const
+{
+	const Entry& entry = meshes[mesh];
+	PoolMesh range;
+	if (entry.vertices == NO_ALLOCATION)
+		return range;
+	range.firstIndex = (unsigned int)(indexStorage.offset(entry.indices) / sizeof(unsigned int));
+	range.indexCount = entry.indexCount;
+	range.baseVertex = (unsigned int)(vertexStorage.offset(entry.vertices) / vertexLayout.stride);
+	range.boundsMin = entry.boundsMin;
+	range.boundsMax = entry.boundsMax;
+	return range;
+}
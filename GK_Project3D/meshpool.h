@@ -0,0 +1,71 @@
+#ifndef MESHPOOL_H
+#define MESHPOOL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "bufferallocator.h"
+#include "mesh.h"
+
+typedef unsigned int MeshHandle;
+const MeshHandle NO_POOL_MESH = 0xFFFFFFFF;
+
+// Where a mesh lives inside the pool buffers. Defragmenting the pool moves meshes,
+// so the ranges are read again from get() every frame.
+struct PoolMesh
+{
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	unsigned int baseVertex = 0;    // added to every index of the mesh
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Static meshes carved out of one large vertex buffer and one 32 bit index buffer behind a single VAO.
+// Every mesh is converted to the 'position, normal, texture coords, tangent, bitangent' layout,
+// attributes a mesh does not have are zero.
+class MeshPool
+{
+public:
+	// Allocates the two buffers, their size cannot change later
+	void create(size_t vertexBytes, size_t indexBytes);
+
+	// Uploads the mesh into free ranges of the pool, NO_POOL_MESH when it does not fit
+	MeshHandle add(const MeshData& data);
+	// Returns the ranges of the mesh to the pool, the handle can be handed out again
+	void remove(MeshHandle mesh);
+	// Packs the meshes to the start of both buffers, leaving the free space in one block
+	void defragment();
+
+	PoolMesh get(MeshHandle mesh) const;
+	unsigned int vertexArray() const { return VAO; }
+	// Another VAO over the pool buffers, for draw lists whose instance attributes must not
+	// replace the ones of the pool VAO. The caller deletes it.
+	unsigned int createVertexArray() const;
+	const VertexLayout& layout() const { return vertexLayout; }
+	BufferAllocatorStats vertexStats() const { return vertexStorage.stats(); }
+	BufferAllocatorStats indexStats() const { return indexStorage.stats(); }
+
+private:
+	void setupVertexArray(unsigned int vertexArray) const;
+
+	struct Entry
+	{
+		BufferAllocation vertices = NO_ALLOCATION;
+		BufferAllocation indices = NO_ALLOCATION;
+		unsigned int indexCount = 0;
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+	};
+
+	VertexLayout vertexLayout = layoutPositionNormalTexTangent();
+	BufferAllocator vertexStorage;
+	BufferAllocator indexStorage;
+	std::vector<Entry> meshes;
+	std::vector<MeshHandle> freeHandles;
+	unsigned int VAO = 0;
+};
+
+#endif
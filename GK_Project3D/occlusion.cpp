@@ -0,0 +1,247 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+// Corners closer to the eye plane than this are not projected, their object counts as visible
+const float MIN_CLIP_W = 1e-4f;
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+	: viewProjection(1.0f)
+{
+	width = std::max(4u, (width + 3) & ~3u);
+	height = std::max(1u, height);
+	while (true)
+	{
+		levels.push_back(std::vector<float>(width * height, 1.0f));
+		levelWidth.push_back(width);
+		levelHeight.push_back(height);
+		if (width == 1 && height == 1)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+
+void OcclusionCuller::begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+	occluders = 0;
+	culled = 0;
+}
+
+
+// OCCLUDERS
+
+static float cross(const glm::vec2& o, const glm::vec2& a, const glm::vec2& b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Counter-clockwise convex hull (monotone chain), hull needs room for 2 * count points
+static unsigned int convexHull(glm::vec2* points, unsigned int count, glm::vec2* hull)
+{
+	std::sort(points, points + count, [](const glm::vec2& a, const glm::vec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+	unsigned int hullCount = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		while (hullCount >= 2 && cross(hull[hullCount - 2], hull[hullCount - 1], points[i]) <= 0.0f)
+			hullCount--;
+		hull[hullCount++] = points[i];
+	}
+	for (int i = (int)count - 2, lower = hullCount + 1; i >= 0; i--)
+	{
+		while ((int)hullCount >= lower && cross(hull[hullCount - 2], hull[hullCount - 1], points[i]) <= 0.0f)
+			hullCount--;
+		hull[hullCount++] = points[i];
+	}
+	return hullCount - 1;
+}
+
+void OcclusionCuller::addOccluder(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	// The box is drawn as its projected outline at the depth of its farthest corner,
+	// so it never hides anything it does not hide for real
+	glm::mat4 transform = viewProjection * model;
+	glm::vec2 points[8];
+	float hullDepth = 0.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = transform * glm::vec4(corner, 1.0f);
+		if (clip.w < MIN_CLIP_W)
+			return;
+		points[i] = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(levelWidth[0], levelHeight[0]);
+		hullDepth = std::max(hullDepth, clip.z / clip.w * 0.5f + 0.5f);
+	}
+	if (hullDepth >= 1.0f)
+		return;
+
+	glm::vec2 hull[16];
+	unsigned int hullCount = convexHull(points, 8, hull);
+	if (hullCount < 3)
+		return;
+	rasterizeHull(hull, hullCount, hullDepth);
+	occluders++;
+}
+
+void OcclusionCuller::rasterizeHull(const glm::vec2* hull, unsigned int hullCount, float hullDepth)
+{
+	const int width = (int)levelWidth[0];
+	const int height = (int)levelHeight[0];
+
+	// Only texels entirely inside the outline can be covered
+	glm::vec2 hullMin = hull[0];
+	glm::vec2 hullMax = hull[0];
+	for (unsigned int i = 1; i < hullCount; i++)
+	{
+		hullMin = glm::min(hullMin, hull[i]);
+		hullMax = glm::max(hullMax, hull[i]);
+	}
+	hullMin = glm::clamp(hullMin, glm::vec2(0.0f), glm::vec2(width, height));
+	hullMax = glm::clamp(hullMax, glm::vec2(0.0f), glm::vec2(width, height));
+	int x0 = (int)std::ceil(hullMin.x);
+	int y0 = (int)std::ceil(hullMin.y);
+	int x1 = (int)std::floor(hullMax.x) - 1;
+	int y1 = (int)std::floor(hullMax.y) - 1;
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	// Edge functions a * x + b * y + c, offset so that they are positive when the whole texel
+	// [x, x + 1] x [y, y + 1] is on the inner side of the edge
+	float a[8], b[8], c[8];
+	for (unsigned int i = 0; i < hullCount; i++)
+	{
+		const glm::vec2& p0 = hull[i];
+		const glm::vec2& p1 = hull[(i + 1) % hullCount];
+		a[i] = p0.y - p1.y;
+		b[i] = p1.x - p0.x;
+		c[i] = -(a[i] * p0.x + b[i] * p0.y) + std::min(0.0f, a[i]) + std::min(0.0f, b[i]);
+	}
+
+	// Rows are walked 4 texels at a time from a multiple of 4, the buffer width is one too
+	x0 &= ~3;
+	std::vector<float>& buffer = levels[0];
+	for (int y = y0; y <= y1; y++)
+	{
+		float* row = &buffer[y * width];
+#ifdef OCCLUSION_SSE
+		__m128 depth = _mm_set1_ps(hullDepth);
+		for (int x = x0; x <= x1; x += 4)
+		{
+			__m128 xs = _mm_setr_ps((float)x, (float)(x + 1), (float)(x + 2), (float)(x + 3));
+			__m128 inside = _mm_cmpeq_ps(depth, depth);
+			for (unsigned int i = 0; i < hullCount; i++)
+			{
+				__m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i]), xs), _mm_set1_ps(b[i] * y + c[i]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, _mm_setzero_ps()));
+			}
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_min_ps(current, depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+#else
+		for (int x = x0; x <= x1; x++)
+		{
+			bool inside = true;
+			for (unsigned int i = 0; i < hullCount && inside; i++)
+				inside = a[i] * x + b[i] * y + c[i] >= 0.0f;
+			if (inside)
+				row[x] = std::min(row[x], hullDepth);
+		}
+#endif
+	}
+}
+
+void OcclusionCuller::finish()
+{
+	// Every texel keeps the farthest depth of the four below it
+	for (unsigned int level = 1; level < levels.size(); level++)
+	{
+		const std::vector<float>& below = levels[level - 1];
+		const unsigned int belowWidth = levelWidth[level - 1];
+		const unsigned int belowHeight = levelHeight[level - 1];
+		std::vector<float>& current = levels[level];
+		for (unsigned int y = 0; y < levelHeight[level]; y++)
+		{
+			unsigned int y0 = 2 * y;
+			unsigned int y1 = std::min(2 * y + 1, belowHeight - 1);
+			for (unsigned int x = 0; x < levelWidth[level]; x++)
+			{
+				unsigned int x0 = 2 * x;
+				unsigned int x1 = std::min(2 * x + 1, belowWidth - 1);
+				current[y * levelWidth[level] + x] = std::max(
+					std::max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+					std::max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+			}
+		}
+	}
+}
+
+
+// TESTS
+
+bool OcclusionCuller::isVisible(const glm::vec3& center, const glm::vec3& extent) const
+{
+	// Screen rectangle and nearest depth of the box
+	glm::vec2 screenMin(std::numeric_limits<float>::max());
+	glm::vec2 screenMax(-std::numeric_limits<float>::max());
+	float nearest = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = center + glm::vec3((i & 1) ? extent.x : -extent.x, (i & 2) ? extent.y : -extent.y, (i & 4) ? extent.z : -extent.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		if (clip.w < MIN_CLIP_W)
+			return true;
+		glm::vec2 screen = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(levelWidth[0], levelHeight[0]);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	const int width = (int)levelWidth[0];
+	const int height = (int)levelHeight[0];
+	if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= width || screenMin.y >= height)
+		return true;
+	screenMin = glm::max(screenMin, glm::vec2(0.0f));
+	screenMax = glm::min(screenMax, glm::vec2(width - 1, height - 1));
+	int x0 = (int)std::floor(screenMin.x);
+	int y0 = (int)std::floor(screenMin.y);
+	int x1 = (int)std::floor(screenMax.x);
+	int y1 = (int)std::floor(screenMax.y);
+
+	// First level where the rectangle touches at most 2x2 texels
+	unsigned int level = 0;
+	while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+		level++;
+
+	float farthest = 0.0f;
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+	{
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			farthest = std::max(farthest, depth(level, x, y));
+	}
+	return nearest <= farthest;
+}
+
+unsigned int OcclusionCuller::cull(const BoundsColumns& bounds, std::vector<unsigned int>& visible)
+{
+	unsigned int kept = 0;
+	for (unsigned int index : visible)
+	{
+		glm::vec3 center(bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index]);
+		glm::vec3 extent(bounds.extentX[index], bounds.extentY[index], bounds.extentZ[index]);
+		if (isVisible(center, extent))
+			visible[kept++] = index;
+	}
+	culled += (unsigned int)visible.size() - kept;
+	visible.resize(kept);
+	return kept;
+}
@@ -0,0 +1,53 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.h"
+
+// Software occlusion culling on the CPU. Boxes of large objects are rasterized into a small
+// depth buffer, a pyramid of farthest depths is built over it and the screen rectangle of
+// every candidate is tested against the pyramid level where it covers at most 2x2 texels.
+// Occluders only ever cover texels they fully hide, so culling is conservative.
+class OcclusionCuller
+{
+public:
+	// The width is rounded up to a multiple of 4 for the SIMD rows
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 192);
+
+	// Clears the depth buffer for a new frame
+	void begin(const glm::mat4& viewProjection);
+	// Rasterizes the box boundsMin..boundsMax placed in the world by model
+	void addOccluder(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// Builds the depth pyramid, call after the last occluder and before testing
+	void finish();
+
+	// False when the world space AABB is certainly hidden behind the occluders
+	bool isVisible(const glm::vec3& center, const glm::vec3& extent) const;
+	// Removes hidden entries from visible (indices into bounds), returns how many are left
+	unsigned int cull(const BoundsColumns& bounds, std::vector<unsigned int>& visible);
+
+	unsigned int width() const { return levelWidth[0]; }
+	unsigned int height() const { return levelHeight[0]; }
+	// Depth in 0..1 (1 is the far plane) of a texel of the given pyramid level
+	float depth(unsigned int level, unsigned int x, unsigned int y) const { return levels[level][y * levelWidth[level] + x]; }
+	unsigned int levelCount() const { return (unsigned int)levels.size(); }
+
+	// Statistics of the last frame
+	unsigned int occluderCount() const { return occluders; }
+	unsigned int culledCount() const { return culled; }
+
+private:
+	void rasterizeHull(const glm::vec2* hull, unsigned int hullCount, float hullDepth);
+
+	glm::mat4 viewProjection;
+	std::vector<std::vector<float>> levels;    // level 0 is the rasterized depth, each next one halves the size
+	std::vector<unsigned int> levelWidth;
+	std::vector<unsigned int> levelHeight;
+	unsigned int occluders = 0;
+	unsigned int culled = 0;
+};
+
+#endif
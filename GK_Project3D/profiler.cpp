@@ -0,0 +1,137 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+// Every buffer ever created, locked only when a thread starts profiling and by the trace
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ProfileThreadBuffer>> registry;
+static thread_local ProfileThreadBuffer* threadBuffer = nullptr;
+
+static void writeEscaped(std::ofstream& out, const char* text)
+{
+	for (; *text; text++)
+	{
+		if (*text == '"' || *text == '\\')
+			out << '\\';
+		if ((unsigned char)*text >= 0x20)
+			out << *text;
+	}
+}
+
+uint64_t profilerNow()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerEpoch).count();
+}
+
+static ProfileThreadBuffer* registerBuffer(const char* name)
+{
+	std::unique_ptr<ProfileThreadBuffer> buffer(new ProfileThreadBuffer());
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->thread = (unsigned int)registry.size();
+	buffer->threadName = name != nullptr ? name : "thread " + std::to_string(buffer->thread);
+	registry.push_back(std::move(buffer));
+	return registry.back().get();
+}
+
+ProfileThreadBuffer& profilerThreadBuffer()
+{
+	if (threadBuffer == nullptr)
+		threadBuffer = registerBuffer(nullptr);
+	return *threadBuffer;
+}
+
+ProfileThreadBuffer& createProfilerTrack(const char* name, const char* category)
+{
+	ProfileThreadBuffer* buffer = registerBuffer(name);
+	buffer->category = category;
+	return *buffer;
+}
+
+void setProfilerThreadName(const char* name)
+{
+	ProfileThreadBuffer& buffer = profilerThreadBuffer();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer.threadName = name;
+}
+
+ProfileZone::ProfileZone(const char* name, const char* detail) : name(name), detail(detail), start(profilerNow())
+{
+}
+
+ProfileZone::~ProfileZone()
+{
+	recordProfileEvent(profilerThreadBuffer(), name, detail, start, profilerNow());
+}
+
+void ProfileZone::next(const char* name)
+{
+	uint64_t now = profilerNow();
+	recordProfileEvent(profilerThreadBuffer(), this->name, detail, start, now);
+	this->name = name;
+	detail = nullptr;
+	start = now;
+}
+
+void recordProfileEvent(ProfileThreadBuffer& buffer, const char* name, const char* detail, uint64_t start, uint64_t end)
+{
+	uint64_t index = buffer.written.load(std::memory_order_relaxed);
+	ProfileEvent& event = buffer.events[index % PROFILER_EVENTS_PER_THREAD];
+	event.name = name;
+	event.start = start;
+	event.duration = end > start ? end - start : 0;
+	event.detail[0] = '\0';
+	if (detail != nullptr)
+	{
+		strncpy(event.detail, detail, PROFILER_DETAIL_LENGTH);
+		event.detail[PROFILER_DETAIL_LENGTH] = '\0';
+	}
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+size_t writeProfilerTrace(const std::string& path)
+{
+	std::ofstream out(path.c_str());
+	if (!out.good())
+		return 0;
+
+	size_t count = 0;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (const std::unique_ptr<ProfileThreadBuffer>& buffer : registry)
+	{
+		out << (count++ > 0 ? ",\n" : "\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+			<< ",\"args\":{\"name\":\"";
+		writeEscaped(out, buffer->threadName.c_str());
+		out << "\"}}";
+
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t first = written > PROFILER_EVENTS_PER_THREAD ? written - PROFILER_EVENTS_PER_THREAD : 0;
+		for (uint64_t i = first; i < written; i++)
+		{
+			const ProfileEvent& event = buffer->events[i % PROFILER_EVENTS_PER_THREAD];
+			// Complete events, timestamps in microseconds
+			out << ",\n{\"name\":\"";
+			writeEscaped(out, event.name);
+			out << "\",\"cat\":\"" << buffer->category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread << ",\"ts\":" << event.start / 1000 << "."
+				<< (event.start % 1000) / 100 << (event.start % 100) / 10 << event.start % 10 << ",\"dur\":" << event.duration / 1000
+				<< "." << (event.duration % 1000) / 100 << (event.duration % 100) / 10 << event.duration % 10;
+			if (event.detail[0] != '\0')
+			{
+				out << ",\"args\":{\"detail\":\"";
+				writeEscaped(out, event.detail);
+				out << "\"}";
+			}
+			out << "}";
+			count++;
+		}
+	}
+	out << "\n]}\n";
+	return out.good() ? count : 0;
+}
@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU zones, on unless the build defines PROFILER_DISABLED. Disabled, the macros expand
+// to nothing and no zone is ever timed.
+#ifndef PROFILER_DISABLED
+#define PROFILER_ENABLED
+#endif
+
+// Zones each thread keeps, the oldest are overwritten first
+const unsigned int PROFILER_EVENTS_PER_THREAD = 16384;
+// Longest detail text a zone keeps, longer ones are cut
+const unsigned int PROFILER_DETAIL_LENGTH = 47;
+
+struct ProfileEvent
+{
+	const char* name;       // string literal, only the pointer is kept
+	uint64_t start;         // nanoseconds since the profiler started
+	uint64_t duration;
+	char detail[PROFILER_DETAIL_LENGTH + 1];
+};
+
+// Written by its own thread only. The write index is published after the event, so a trace
+// taken while the thread runs sees whole events, apart from the ones it overwrites meanwhile.
+struct ProfileThreadBuffer
+{
+	ProfileEvent events[PROFILER_EVENTS_PER_THREAD];
+	std::atomic<uint64_t> written{ 0 };
+	unsigned int thread = 0;
+	std::string threadName;
+	const char* category = "cpu";       // of its events in the trace
+};
+
+uint64_t profilerNow();
+// Buffer of the calling thread, created by its first zone. Buffers outlive their threads.
+ProfileThreadBuffer& profilerThreadBuffer();
+// Names the calling thread in the trace, others are "thread N"
+void setProfilerThreadName(const char* name);
+// A named lane of the trace not tied to a thread, for events timed elsewhere (the GPU). It must
+// only be written by one thread.
+ProfileThreadBuffer& createProfilerTrack(const char* name, const char* category);
+// Adds a finished zone, times from profilerNow()
+void recordProfileEvent(ProfileThreadBuffer& buffer, const char* name, const char* detail, uint64_t start, uint64_t end);
+// Writes the zones every thread still holds as Chrome trace event JSON, which chrome://tracing
+// and Perfetto open. Returns the number of events written, 0 when the file could not be opened.
+size_t writeProfilerTrace(const std::string& path);
+
+// Times its own lifetime on the thread that created it
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name, const char* detail = nullptr);
+	~ProfileZone();
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+	// Ends the zone and starts the next one, for consecutive sections of one scope
+	void next(const char* name);
+
+private:
+	const char* name;
+	const char* detail;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef PROFILER_ENABLED
+// Name must be a string literal, the detail (a file path) is copied when the zone ends
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_SCOPE_DETAIL(name, detail) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name, detail)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+// One section zone per scope, each PROFILE_NEXT_SECTION ends the previous one
+#define PROFILE_SECTION(name) ProfileZone profileSection(name)
+#define PROFILE_NEXT_SECTION(name) profileSection.next(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_DETAIL(name, detail) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_SECTION(name) ((void)0)
+#define PROFILE_NEXT_SECTION(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,308 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "renderstats.h"
+
+const char* const renderPassNames[RENDER_PASS_COUNT] = { "depth pre-pass", "opaque", "lighting", "sky" };
+
+RenderCommand RenderCommand::forMesh(unsigned int pass, Shader* shader, MaterialHandle material, const Mesh& mesh, const glm::mat4* model)
+{
+	RenderCommand command;
+	command.pass = pass;
+	command.shader = shader;
+	command.material = material;
+	command.VAO = mesh.VAO;
+	command.indexType = mesh.indexType;
+	command.count = mesh.indexCount;
+	command.model = model;
+	return command;
+}
+
+RenderCommand RenderCommand::forInstances(unsigned int pass, Shader* shader, MaterialHandle material, const Mesh& mesh, unsigned int instanceCount)
+{
+	RenderCommand command = forMesh(pass, shader, material, mesh, nullptr);
+	command.instanceCount = instanceCount;
+	return command;
+}
+
+RenderCommand RenderCommand::forArrays(unsigned int pass, Shader* shader, MaterialHandle material, unsigned int VAO, unsigned int vertexCount)
+{
+	RenderCommand command;
+	command.pass = pass;
+	command.shader = shader;
+	command.material = material;
+	command.VAO = VAO;
+	command.count = vertexCount;
+	return command;
+}
+
+RenderCommand RenderCommand::forIndirect(unsigned int pass, Shader* shader, IndirectDrawList& list, const IndirectBatch& batch)
+{
+	RenderCommand command;
+	command.pass = pass;
+	command.shader = shader;
+	command.material = batch.material;
+	command.VAO = list.vertexArray();
+	command.indexType = GL_UNSIGNED_INT;
+	command.count = batch.commandCount;
+	command.instanceCount = 1;      // matrices come from the instance attributes
+	command.indirect = &list;
+	command.firstCommand = batch.firstCommand;
+	return command;
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int VAO, float depth,
+	RenderSortMode mode)
+{
+	// GL names are small numbers, their low bits are enough to group equal state
+	uint64_t depthBits = (uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * 0xFFFFFF);
+	uint64_t stateBits = ((uint64_t)(shader & 0xFF) << 28) | ((uint64_t)(material & 0xFFFF) << 12) | (uint64_t)(VAO & 0xFFF);
+	if (mode == RENDER_SORT_FRONT_TO_BACK)
+		return ((uint64_t)(pass & 0xF) << 60) | (depthBits << 36) | stateBits;
+	return ((uint64_t)(pass & 0xF) << 60) | (stateBits << 24) | depthBits;
+}
+
+void RenderQueue::clear()
+{
+	commands.clear();
+	keys.clear();
+}
+
+void RenderQueue::submit(const RenderCommand& command, float depth)
+{
+	commands.push_back(command);
+	keys.push_back(makeKey(command.pass, command.shader->ID, command.material, command.VAO, depth, sortMode));
+}
+
+void RenderQueue::sort()
+{
+	const unsigned int count = (unsigned int)keys.size();
+	order.resize(count);
+	scratch.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		order[i] = i;
+	if (count < 2)
+		return;
+
+	// Least significant digit first, 8 bits per pass. The histograms of all passes are
+	// counted at once and digits every key shares are skipped.
+	unsigned int histograms[8][256] = {};
+	for (uint64_t key : keys)
+	{
+		for (int digit = 0; digit < 8; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	for (int digit = 0; digit < 8; digit++)
+	{
+		unsigned int* histogram = histograms[digit];
+		if (histogram[(keys[0] >> (digit * 8)) & 0xFF] == count)
+			continue;
+
+		unsigned int offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			unsigned int bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+		for (unsigned int index : order)
+			scratch[histogram[(keys[index] >> (digit * 8)) & 0xFF]++] = index;
+		order.swap(scratch);
+	}
+}
+
+// After a depth pre-pass the opaque pass only shades the fragments whose depth it wrote.
+// Light volumes draw their back faces where they lie behind the scene, clamped instead of
+// clipped at the far plane, and add up. The sky lies on the far plane and writes no depth, so
+// the depth test drops it in front of the scene before its fragment shader runs.
+static void applyPassState(unsigned int pass, bool depthPrepass)
+{
+	bool shadeEqual = pass == RENDER_PASS_OPAQUE && depthPrepass;
+	bool lighting = pass == RENDER_PASS_LIGHTING;
+	glState.colorMask(pass != RENDER_PASS_DEPTH);
+	glState.depthMask(!shadeEqual && !lighting && pass != RENDER_PASS_SKY);
+	if (lighting)
+		glState.depthFunc(GL_GEQUAL);
+	else
+		glState.depthFunc(pass == RENDER_PASS_SKY ? GL_LEQUAL : (shadeEqual ? GL_EQUAL : GL_LESS));
+	glState.setEnabled(GL_BLEND, lighting);
+	glState.setEnabled(GL_CULL_FACE, lighting);
+	glState.setEnabled(GL_DEPTH_CLAMP, lighting);
+	if (lighting)
+	{
+		glState.blendFunc(GL_ONE, GL_ONE);
+		glState.cullFace(GL_FRONT);
+	}
+}
+
+// Binds the framebuffer of the next pass, carrying the depth of the previous one over
+static void switchFramebuffer(unsigned int from, unsigned int to)
+{
+	if (from != to)
+	{
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glState.bindFramebuffer(GL_READ_FRAMEBUFFER, from);
+		glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, to);
+		glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+			viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+	glState.bindFramebuffer(GL_FRAMEBUFFER, to);
+}
+
+void RenderQueue::execute(const std::vector<Material>& materials, RingBuffer& ring)
+{
+	lastStats = RenderQueueStats();
+
+	// Queries of this slot were issued RING_BUFFER_FRAMES executes ago. A result that is still
+	// not ready is dropped rather than waited for.
+	unsigned int* queries = sampleQueries[queryFrame];
+	bool* issued = queryIssued[queryFrame];
+	if (queries[0] == 0)
+		glGenQueries(RENDER_PASS_COUNT, queries);
+	for (unsigned int p = 0; p < RENDER_PASS_COUNT; p++)
+	{
+		if (!issued[p])
+		{
+			samplesPassed[p] = 0;
+			continue;
+		}
+		GLuint available = 0;
+		glGetQueryObjectuiv(queries[p], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+			glGetQueryObjectuiv(queries[p], GL_QUERY_RESULT, &samplesPassed[p]);
+		issued[p] = false;
+	}
+	memcpy(lastStats.samplesPassed, samplesPassed, sizeof(samplesPassed));
+	queryFrame = (queryFrame + 1) % RING_BUFFER_FRAMES;
+
+	// Per-draw data goes into the ring before any draw reads it. Neighbouring draws with the
+	// same data share one copy. Draws whose data did not fit are skipped this frame.
+	drawDataOffsets.resize(order.size());
+	DrawData previous;
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		const RenderCommand& command = commands[order[i]];
+		DrawData data = DrawData();
+		data.model = command.model != nullptr ? *command.model : glm::mat4(1.0f);
+		data.instanced = command.instanceCount > 0 ? 1 : 0;
+		data.normalMapping = command.material != NO_MATERIAL && materials[command.material].normalMapping ? 1 : 0;
+		if (i == 0 || memcmp(&data, &previous, sizeof(DrawData)) != 0)
+		{
+			drawDataOffsets[i] = ring.write(data);
+			previous = data;
+			lastStats.drawDataWrites++;
+		}
+		else
+			drawDataOffsets[i] = drawDataOffsets[i - 1];
+	}
+	ring.flush();
+
+	unsigned int pass = RENDER_PASS_COUNT;
+	unsigned int framebuffer = 0;
+	bool depthPrepass = false;
+	Shader* shader = nullptr;
+	MaterialHandle material = NO_MATERIAL;
+	unsigned int VAO = 0xFFFFFFFF;
+	size_t drawData = (size_t)-1;
+
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		const RenderCommand& command = commands[order[i]];
+		if (drawDataOffsets[i] == RING_BUFFER_FULL)
+		{
+			lastStats.skippedDraws++;
+			continue;
+		}
+		if (command.pass != pass)
+		{
+			if (pass != RENDER_PASS_COUNT)
+			{
+				glEndQuery(GL_SAMPLES_PASSED);
+				if (gpuProfiler != nullptr)
+					gpuProfiler->endZone();
+			}
+			bool first = pass == RENDER_PASS_COUNT;
+			depthPrepass = depthPrepass || pass == RENDER_PASS_DEPTH;
+			pass = command.pass;
+			if (gpuProfiler != nullptr)
+				gpuProfiler->beginZone(renderPassNames[pass]);
+			if (first)
+				glState.bindFramebuffer(GL_FRAMEBUFFER, passFramebuffers[pass]);
+			else
+				switchFramebuffer(framebuffer, passFramebuffers[pass]);
+			framebuffer = passFramebuffers[pass];
+			applyPassState(pass, depthPrepass);
+			glBeginQuery(GL_SAMPLES_PASSED, queries[pass]);
+			issued[pass] = true;
+		}
+
+		if (command.shader != shader)
+		{
+			shader = command.shader;
+			shader->use();
+			lastStats.shaderBinds++;
+		}
+		else
+			lastStats.elidedBinds++;
+
+		if (command.material != material && command.material != NO_MATERIAL)
+		{
+			material = command.material;
+			materials[material].bind();
+			lastStats.materialBinds++;
+		}
+		else
+			lastStats.elidedBinds++;
+
+		if (command.VAO != VAO)
+		{
+			VAO = command.VAO;
+			glState.bindVertexArray(VAO);
+			lastStats.vertexArrayBinds++;
+		}
+		else
+			lastStats.elidedBinds++;
+
+		if (drawDataOffsets[i] != drawData)
+		{
+			drawData = drawDataOffsets[i];
+			ring.bindRange(DRAW_DATA_BINDING, drawData, sizeof(DrawData));
+			lastStats.drawDataBinds++;
+		}
+		else
+			lastStats.elidedBinds++;
+
+		if (command.indirect != nullptr)
+			command.indirect->draw(command.firstCommand, command.count);
+		else if (command.indexType == GL_NONE)
+		{
+			glDrawArrays(GL_TRIANGLES, 0, command.count);
+			renderStats.countDraw(GL_TRIANGLES, command.count);
+		}
+		else if (command.instanceCount > 0)
+		{
+			glDrawElementsInstanced(GL_TRIANGLES, command.count, command.indexType, (void*)0, command.instanceCount);
+			renderStats.countDraw(GL_TRIANGLES, command.count, command.instanceCount);
+		}
+		else
+		{
+			glDrawElements(GL_TRIANGLES, command.count, command.indexType, (void*)0);
+			renderStats.countDraw(GL_TRIANGLES, command.count);
+		}
+		lastStats.draws++;
+	}
+
+	if (pass != RENDER_PASS_COUNT)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		if (gpuProfiler != nullptr)
+			gpuProfiler->endZone();
+	}
+	glState.bindVertexArray(0);
+	glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	applyPassState(RENDER_PASS_OPAQUE, false);
+}
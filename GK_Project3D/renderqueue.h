@@ -0,0 +1,129 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "framedata.h"
+#include "gpuprofiler.h"
+#include "indirect.h"
+#include "material.h"
+#include "mesh.h"
+#include "ringbuffer.h"
+#include "shader.h"
+
+// Passes run in this order, each one can change fixed function state
+enum RenderPass
+{
+	RENDER_PASS_DEPTH,      // depth only pre-pass, the opaque pass then shades with depth test EQUAL
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_LIGHTING,   // deferred light volumes, added together where their back faces lie behind the scene
+	RENDER_PASS_SKY,        // drawn last with depth test LEQUAL and no depth writes, where nothing else was drawn
+	RENDER_PASS_COUNT
+};
+
+extern const char* const renderPassNames[RENDER_PASS_COUNT];
+
+// Everything needed to issue one draw call
+struct RenderCommand
+{
+	unsigned int pass = RENDER_PASS_OPAQUE;
+	Shader* shader = nullptr;
+	MaterialHandle material = NO_MATERIAL;
+	unsigned int VAO = 0;
+	GLenum indexType = GL_NONE;         // GL_NONE draws arrays
+	unsigned int count = 0;             // indices or vertices
+	unsigned int instanceCount = 0;     // 0 draws one copy placed by model
+	const glm::mat4* model = nullptr;   // must stay valid until execute()
+	IndirectDrawList* indirect = nullptr;   // set for batches of a draw list, count is then the number of commands
+	unsigned int firstCommand = 0;
+
+	static RenderCommand forMesh(unsigned int pass, Shader* shader, MaterialHandle material, const Mesh& mesh, const glm::mat4* model);
+	static RenderCommand forInstances(unsigned int pass, Shader* shader, MaterialHandle material, const Mesh& mesh, unsigned int instanceCount);
+	static RenderCommand forArrays(unsigned int pass, Shader* shader, MaterialHandle material, unsigned int VAO, unsigned int vertexCount);
+	static RenderCommand forIndirect(unsigned int pass, Shader* shader, IndirectDrawList& list, const IndirectBatch& batch);
+};
+
+// How draws are ordered inside a pass
+enum RenderSortMode
+{
+	RENDER_SORT_STATE,          // shader, material and mesh first, then front to back
+	RENDER_SORT_FRONT_TO_BACK   // nearest first, state only breaks ties
+};
+
+// Binds issued and skipped by the last execute()
+struct RenderQueueStats
+{
+	unsigned int draws = 0;
+	unsigned int shaderBinds = 0;
+	unsigned int materialBinds = 0;
+	unsigned int vertexArrayBinds = 0;
+	unsigned int drawDataWrites = 0;
+	unsigned int drawDataBinds = 0;
+	unsigned int elidedBinds = 0;
+	unsigned int skippedDraws = 0;     // their draw data did not fit in the ring
+	// Samples that passed the depth test in each pass, from an execute() RING_BUFFER_FRAMES frames earlier
+	unsigned int samplesPassed[RENDER_PASS_COUNT] = {};
+
+	// Fragments the depth pre-pass kept from being shaded, 0 without one
+	unsigned int fragmentsSaved() const
+	{
+		unsigned int depth = samplesPassed[RENDER_PASS_DEPTH], opaque = samplesPassed[RENDER_PASS_OPAQUE];
+		return depth > opaque ? depth - opaque : 0;
+	}
+};
+
+// Draws of one frame, each with a 64 bit key:
+//   pass (4) | shader (8) | material (16) | vertex array (12) | depth (24)
+// Radix sorting the keys groups draws that share state and orders each group front to back,
+// execute() then only binds what differs from the previous draw. RENDER_SORT_FRONT_TO_BACK
+// moves the depth right after the pass.
+// Every pass is wrapped in a GL_SAMPLES_PASSED query, read back once the result is ready, and
+// in a zone of the GPU profiler when one is set.
+// A pass draws into the framebuffer set for it. When the framebuffer changes between passes the
+// depth drawn so far is copied over, so later passes still test against the scene.
+class RenderQueue
+{
+public:
+	static uint64_t makeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int VAO, float depth,
+		RenderSortMode mode = RENDER_SORT_STATE);
+
+	// Applies to draws submitted after the call
+	void setSortMode(RenderSortMode mode) { sortMode = mode; }
+	RenderSortMode getSortMode() const { return sortMode; }
+	// 0 is the default framebuffer, which every pass draws into until set otherwise
+	void setPassFramebuffer(unsigned int pass, unsigned int framebuffer) { passFramebuffers[pass] = framebuffer; }
+	// Times every pass as a zone named after it, nullptr stops timing
+	void setGpuProfiler(GpuProfiler* profiler) { gpuProfiler = profiler; }
+
+	void clear();
+	// depth is 0 at the camera and 1 at the far plane
+	void submit(const RenderCommand& command, float depth);
+	void sort();
+	// Writes the per-draw data of every command into the ring, flushes it and draws
+	void execute(const std::vector<Material>& materials, RingBuffer& ring);
+
+	unsigned int size() const { return (unsigned int)commands.size(); }
+	const RenderQueueStats& stats() const { return lastStats; }
+
+private:
+	std::vector<RenderCommand> commands;
+	std::vector<uint64_t> keys;
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> scratch;
+	std::vector<size_t> drawDataOffsets;    // per position in order
+	RenderQueueStats lastStats;
+	RenderSortMode sortMode = RENDER_SORT_STATE;
+	unsigned int passFramebuffers[RENDER_PASS_COUNT] = {};
+	GpuProfiler* gpuProfiler = nullptr;
+
+	unsigned int sampleQueries[RING_BUFFER_FRAMES][RENDER_PASS_COUNT] = {};
+	bool queryIssued[RING_BUFFER_FRAMES][RENDER_PASS_COUNT] = {};
+	unsigned int queryFrame = 0;
+	unsigned int samplesPassed[RENDER_PASS_COUNT] = {};
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "renderstats.h"
+
+#include <iostream>
+
+#include "benchmark.h"
+#include "glstate.h"
+
+RenderStats renderStats;
+
+void RenderCounters::add(const RenderCounters& other)
+{
+	drawCalls += other.drawCalls;
+	drawCommands += other.drawCommands;
+	triangles += other.triangles;
+	vertices += other.vertices;
+	uniformUpdates += other.uniformUpdates;
+	programSwitches += other.programSwitches;
+	vertexArrayBinds += other.vertexArrayBinds;
+	textureBinds += other.textureBinds;
+	bufferBytes += other.bufferBytes;
+	textureBytes += other.textureBytes;
+}
+
+void RenderStats::countDraw(GLenum mode, uint64_t vertices, uint64_t instances, uint64_t commands)
+{
+	frame.drawCalls++;
+	frame.drawCommands += commands;
+	frame.vertices += vertices * instances;
+	if (mode == GL_TRIANGLES)
+		frame.triangles += vertices / 3 * instances;
+}
+
+void RenderStats::beginFrame()
+{
+	frame = RenderCounters();
+	glState.resetCounters();
+}
+
+void RenderStats::endFrame()
+{
+	const StateCallCounters& calls = glState.counters();
+	frame.programSwitches = calls.issued[STATE_CALL_PROGRAM];
+	frame.vertexArrayBinds = calls.issued[STATE_CALL_VERTEX_ARRAY];
+	frame.textureBinds = calls.issued[STATE_CALL_TEXTURE];
+
+	last = frame;
+	period.add(frame);
+	periodFrames++;
+	runTotal.add(frame);
+	totalFrames++;
+}
+
+RenderCounters RenderStats::takePeriod(unsigned int& frames)
+{
+	RenderCounters sum = period;
+	frames = periodFrames;
+	period = RenderCounters();
+	periodFrames = 0;
+	return sum;
+}
+
+void RenderStats::print(const RenderCounters& sum, unsigned int frames, const char* label)
+{
+	if (frames == 0)
+		return;
+	double n = frames;
+	std::cout << label << ", per frame over " << frames << " frames: " << sum.drawCalls / n << " draw calls ("
+		<< sum.drawCommands / n << " draws), " << sum.triangles / n << " triangles, " << sum.vertices / n << " vertices, "
+		<< sum.uniformUpdates / n << " uniform updates, " << sum.programSwitches / n << " program switches, "
+		<< sum.vertexArrayBinds / n << " VAO binds, " << sum.textureBinds / n << " texture binds, "
+		<< sum.bufferBytes / n / 1024.0 << " KB to buffers, " << sum.textureBytes / n / 1024.0 << " KB to textures" << std::endl;
+}
+
+void RenderStats::report(BenchmarkReport& report, unsigned int objects) const
+{
+	if (totalFrames == 0)
+		return;
+	double n = totalFrames;
+	report.add("render_draw_calls", objects, 1, runTotal.drawCalls / n, "per frame");
+	report.add("render_draw_commands", objects, 1, runTotal.drawCommands / n, "per frame");
+	report.add("render_triangles", objects, 1, runTotal.triangles / n, "per frame");
+	report.add("render_vertices", objects, 1, runTotal.vertices / n, "per frame");
+	report.add("render_uniform_updates", objects, 1, runTotal.uniformUpdates / n, "per frame");
+	report.add("render_program_switches", objects, 1, runTotal.programSwitches / n, "per frame");
+	report.add("render_vertex_array_binds", objects, 1, runTotal.vertexArrayBinds / n, "per frame");
+	report.add("render_texture_binds", objects, 1, runTotal.textureBinds / n, "per frame");
+	report.add("render_buffer_upload", objects, 1, runTotal.bufferBytes / n / 1024.0, "KB/frame");
+	report.add("render_texture_upload", objects, 1, runTotal.textureBytes / n / 1024.0, "KB/frame");
+}
@@ -0,0 +1,66 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class BenchmarkReport;
+
+// Work handed to GL in one frame
+struct RenderCounters
+{
+	uint64_t drawCalls = 0;         // API calls, a multi-draw counts once
+	uint64_t drawCommands = 0;      // draws those calls made, one per command of a multi-draw
+	uint64_t triangles = 0;         // over all instances
+	uint64_t vertices = 0;          // vertices (indices of indexed draws) read, over all instances
+	uint64_t uniformUpdates = 0;    // glUniform calls
+	uint64_t programSwitches = 0;   // issued through glState, elided ones are not counted
+	uint64_t vertexArrayBinds = 0;
+	uint64_t textureBinds = 0;
+	uint64_t bufferBytes = 0;       // given to glBufferData, glBufferSubData or written to mapped ring buffers
+	uint64_t textureBytes = 0;      // pixel data given to glTexImage
+
+	void add(const RenderCounters& other);
+};
+
+// Per-frame counters of the GL work. Draws, uniform updates and uploads are counted next to
+// the calls that make them, binds come from the call counters of glState. endFrame() keeps the
+// frame, which then shows in lastFrame() and the averages.
+class RenderStats
+{
+public:
+	void countDraw(GLenum mode, uint64_t vertices, uint64_t instances = 1, uint64_t commands = 1);
+	void countUniform() { frame.uniformUpdates++; }
+	void countBufferUpload(size_t bytes) { frame.bufferBytes += bytes; }
+	void countTextureUpload(size_t bytes) { frame.textureBytes += bytes; }
+
+	// Starts counting a frame, also resets the glState counters
+	void beginFrame();
+	void endFrame();
+
+	const RenderCounters& lastFrame() const { return last; }
+	// Sum of the frames ended since the last call, then starts a new period
+	RenderCounters takePeriod(unsigned int& frames);
+	// Sum of every frame ended
+	const RenderCounters& total() const { return runTotal; }
+	unsigned int frameCount() const { return totalFrames; }
+
+	// Prints the average frame of a sum of frames
+	static void print(const RenderCounters& sum, unsigned int frames, const char* label);
+	// One row per counter, the average per frame over the run
+	void report(BenchmarkReport& report, unsigned int objects) const;
+
+private:
+	RenderCounters frame;
+	RenderCounters last;
+	RenderCounters period;
+	unsigned int periodFrames = 0;
+	RenderCounters runTotal;
+	unsigned int totalFrames = 0;
+};
+
+extern RenderStats renderStats;
+
+#endif
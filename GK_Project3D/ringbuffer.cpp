@@ -0,0 +1,141 @@
+#include "ringbuffer.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "renderstats.h"
+
+void RingBuffer::create(GLenum target, size_t frameSize)
+{
+	this->target = target;
+	GLint offsetAlignment = 256;
+	if (target == GL_UNIFORM_BUFFER)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	alignment = (size_t)offsetAlignment;
+	allocate(frameSize);
+	frame = RING_BUFFER_FRAMES - 1;
+}
+
+void RingBuffer::allocate(size_t frameSize)
+{
+	this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &bufferName);
+	glBindBuffer(target, bufferName);
+	persistent = bufferStorageSupported();
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		createBufferStorage(target, this->frameSize * RING_BUFFER_FRAMES, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(target, 0, this->frameSize * RING_BUFFER_FRAMES, flags);
+		if (mapped == nullptr)
+			std::cout << "ERROR::RING_BUFFER::MAP_FAILED" << std::endl;
+	}
+	else
+		glBufferData(target, this->frameSize * RING_BUFFER_FRAMES, NULL, GL_STREAM_DRAW);
+	glBindBuffer(target, 0);
+}
+
+void RingBuffer::grow(size_t frameSize)
+{
+	// Any region of the old buffer may still be read
+	for (GLsync& fence : fences)
+	{
+		if (fence == nullptr)
+			continue;
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (persistent && mapped != nullptr)
+	{
+		glBindBuffer(target, bufferName);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+	}
+	mapped = nullptr;
+	glDeleteBuffers(1, &bufferName);
+
+	// A quarter more, so a slowly growing frame does not grow the ring every frame
+	allocate(frameSize + frameSize / 4);
+	std::cout << "Ring buffer grown to " << this->frameSize << " bytes per frame" << std::endl;
+	overflowReported = false;
+}
+
+void RingBuffer::beginFrame()
+{
+	if (demand > frameSize)
+		grow(demand);
+	demand = 0;
+	frame = (frame + 1) % RING_BUFFER_FRAMES;
+	cursor = 0;
+
+	// Normally long signalled, a zero timeout poll tells whether the GPU is behind
+	if (fences[frame] != nullptr)
+	{
+		if (glClientWaitSync(fences[frame], 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			stallCount++;
+			while (glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+				;
+		}
+		glDeleteSync(fences[frame]);
+		fences[frame] = nullptr;
+	}
+
+	if (!persistent)
+	{
+		// The fence already protects the region, so the driver does not need to synchronize
+		glBindBuffer(target, bufferName);
+		mapped = (unsigned char*)glMapBufferRange(target, frame * frameSize, frameSize,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(target, 0);
+	}
+}
+
+size_t RingBuffer::write(const void* data, size_t size)
+{
+	size_t regionStart = persistent ? frame * frameSize : 0;
+	size_t alignedSize = (size + alignment - 1) / alignment * alignment;
+	demand += alignedSize;
+	if (cursor + size > frameSize)
+	{
+		if (!overflowReported)
+			std::cout << "ERROR::RING_BUFFER::FRAME_FULL " << frameSize << " bytes, writes are dropped until it grows" << std::endl;
+		overflowReported = true;
+		return RING_BUFFER_FULL;
+	}
+
+	size_t offset = cursor;
+	if (mapped != nullptr)
+	{
+		memcpy(mapped + regionStart + offset, data, size);
+		renderStats.countBufferUpload(size);
+	}
+	cursor += alignedSize;
+	return frame * frameSize + offset;
+}
+
+void RingBuffer::flush()
+{
+	if (persistent || mapped == nullptr)
+		return;
+	glBindBuffer(target, bufferName);
+	glUnmapBuffer(target);
+	glBindBuffer(target, 0);
+	mapped = nullptr;
+}
+
+void RingBuffer::endFrame()
+{
+	flush();
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RingBuffer::bindRange(unsigned int binding, size_t offset, size_t size) const
+{
+	if (offset == RING_BUFFER_FULL)
+		return;
+	glBindBufferRange(target, binding, bufferName, offset, size);
+}
@@ -0,0 +1,70 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+#include "bufferallocator.h"
+
+// Frames the CPU can be ahead of the GPU before it has to wait
+const unsigned int RING_BUFFER_FRAMES = 3;
+// Returned by write() when the frame's region has no room left
+const size_t RING_BUFFER_FULL = (size_t)-1;
+
+// Per-frame GPU data in one buffer split into RING_BUFFER_FRAMES regions. The buffer stays mapped
+// (persistent and coherent) and write() is a memcpy into the current region. A fence placed at
+// endFrame() guards each region, so the CPU only waits when it is a whole ring ahead of the GPU.
+// Without buffer storage each region is mapped unsynchronized for the frame instead, and flush()
+// unmaps it before drawing. A frame that writes more than its region holds gets RING_BUFFER_FULL
+// for the writes past the end, and the next beginFrame() grows every region to fit that frame.
+class RingBuffer
+{
+public:
+	RingBuffer() {}
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	// Each write is aligned for glBindBufferRange on target
+	void create(GLenum target, size_t frameSize);
+
+	// Moves to the next region, waiting for the GPU only if it still reads it. Growing after a
+	// full frame waits for every region.
+	void beginFrame();
+	// Copies data into the current region and returns its offset in the buffer, RING_BUFFER_FULL
+	// when it does not fit. Memory written earlier in the frame is never reused.
+	size_t write(const void* data, size_t size);
+	template <typename T>
+	size_t write(const T& value) { return write(&value, sizeof(T)); }
+	// Makes the writes visible to draws, must be called before drawing with them
+	void flush();
+	// Fences the commands that read the current region
+	void endFrame();
+
+	// An offset of RING_BUFFER_FULL keeps the previous binding
+	void bindRange(unsigned int binding, size_t offset, size_t size) const;
+
+	unsigned int buffer() const { return bufferName; }
+	size_t frameUsed() const { return cursor; }
+	// Frames in which beginFrame() had to wait for the GPU
+	unsigned int stalls() const { return stallCount; }
+
+private:
+	void allocate(size_t frameSize);
+	void grow(size_t frameSize);
+
+	GLenum target = GL_UNIFORM_BUFFER;
+	unsigned int bufferName = 0;
+	size_t frameSize = 0;
+	size_t alignment = 1;
+	bool persistent = false;
+	unsigned char* mapped = nullptr;        // whole buffer when persistent, current region otherwise
+	unsigned int frame = 0;
+	size_t cursor = 0;
+	size_t demand = 0;                      // bytes the frame asked for, written or not
+	bool overflowReported = false;
+	GLsync fences[RING_BUFFER_FRAMES] = {};
+	unsigned int stallCount = 0;
+};
+
+#endif
@@ -4,32 +4,9 @@ struct Material {
     sampler2D diffuse;
     sampler2D specular;
     sampler2D normal;
-    float shininess;
 };
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-
-    float cutOff;
-    float outerCutOff;
-  
-    float constant;
-    float linear;
-    float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
-};
+#include "framedata.glsl"
 
 in VS_OUT {
     vec3 FragPos;
@@ -43,16 +20,13 @@ in VS_OUT {
 
 out vec4 FragColor;
 
-uniform vec3 fogColor;
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform SpotLight spotLight;
-uniform SpotLight spotLightMoving;
 uniform Material material;
-uniform bool normalMapping;
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, bool normalMap);
+#include "dirshadow.glsl"
+#include "spotshadow.glsl"
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, bool normalMap, float shadow);
 
 
 void main()
@@ -65,16 +39,17 @@ void main()
         norm = normalize(norm * 2.0 - 1.0);
     }
 
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    result += CalcSpotLight(spotLight, norm, fs_in.FragPos, viewDir, normalMapping);
-    result += CalcSpotLight(spotLightMoving, norm, fs_in.FragPos, viewDir, false);
+    vec3 surfaceNormal = normalize(fs_in.Normal);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, DirShadow(fs_in.FragPos, surfaceNormal));
+    result += CalcSpotLight(spotLight, norm, fs_in.FragPos, viewDir, normalMapping, SpotShadow(0, fs_in.FragPos, surfaceNormal));
+    result += CalcSpotLight(spotLightMoving, norm, fs_in.FragPos, viewDir, false, SpotShadow(1, fs_in.FragPos, surfaceNormal));
 
     result = mix(fogColor, result, fs_in.fogFactor);
     FragColor = vec4(result, 1.0);
 }
 
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     
@@ -87,13 +62,13 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 
     // Specular
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
 
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * shadow);
 }
 
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, bool normalMap)
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, bool normalMap, float shadow)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     if (normalMap)
@@ -111,7 +86,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, boo
 
     // Specular
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, fs_in.TexCoords));
     
     // Attenuation
@@ -124,8 +99,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, boo
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
     ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
+    diffuse *= attenuation * intensity * shadow;
+    specular *= attenuation * intensity * shadow;
 
     return (ambient + diffuse + specular);
 }
\ No newline at end of file
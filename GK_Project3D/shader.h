@@ -3,6 +3,10 @@
 
 #include <glad/glad.h>
 
+#include "glstate.h"
+#include "profiler.h"
+#include "renderstats.h"
+
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -24,6 +28,7 @@ public:
 
 	Shader(const char* vertexPath, const char* fragmentPath)
 	{
+		PROFILE_SCOPE_DETAIL("Shader", vertexPath);
 		// Get source code from filePath
 		std::string vertexCode;
 		std::string fragmentCode;
@@ -52,6 +57,8 @@ public:
 		{
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 		}
+		vertexCode = resolveIncludes(vertexCode);
+		fragmentCode = resolveIncludes(fragmentCode);
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
 
@@ -98,32 +105,77 @@ public:
 
 	void use()
 	{
-		glUseProgram(ID);
+		glState.useProgram(ID);
+	}
+
+	// Connects a uniform block of the program to a buffer binding point, shaders without it are skipped
+	void setBlockBinding(const std::string& name, unsigned int binding) const
+	{
+		unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, index, binding);
 	}
 
 	void setBool(const std::string& name, bool value) const
 	{
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		renderStats.countUniform();
 	}
 	void setInt(const std::string& name, int value) const
 	{
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		renderStats.countUniform();
 	}
 	void setFloat(const std::string& name, float value) const
 	{
 		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		renderStats.countUniform();
 	}
 	void setMat4(const std::string& name, const glm::mat4 value) const
 	{
 		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+		renderStats.countUniform();
 	}
 	void setVec3(const std::string& name, float x, float y, float z) const
 	{
 		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		renderStats.countUniform();
 	}
 	void setVec3(const std::string& name, const glm::vec3& value) const
 	{
 		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		renderStats.countUniform();
+	}
+
+private:
+	// Replaces every line #include "file" with the file, so helpers shared by several shaders
+	// live in one place. Paths are relative to the working directory, like the shaders.
+	static std::string resolveIncludes(const std::string& source)
+	{
+		std::istringstream lines(source);
+		std::ostringstream resolved;
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			size_t open = line.find('"');
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (line.compare(0, 8, "#include") != 0 || close == std::string::npos)
+			{
+				resolved << line << '\n';
+				continue;
+			}
+			std::string path = line.substr(open + 1, close - open - 1);
+			std::ifstream file(path.c_str());
+			if (!file.good())
+			{
+				std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << path << std::endl;
+				continue;
+			}
+			std::stringstream included;
+			included << file.rdbuf();
+			resolved << resolveIncludes(included.str()) << '\n';
+		}
+		return resolved.str();
 	}
 };
 
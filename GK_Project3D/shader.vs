@@ -5,6 +5,12 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
+layout (location = 5) in mat4 aInstanceModel;
+
+#include "framedata.glsl"
+
+// Matches the depth pre-pass bit for bit
+invariant gl_Position;
 
 out VS_OUT {
     vec3 FragPos;
@@ -17,21 +23,16 @@ out VS_OUT {
 } vs_out;
 
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-uniform vec3 lightPos;
-uniform vec3 cameraPos;
-
 void main()
 {
-	vs_out.FragPos = vec3(view * model * vec4(aPos, 1.0));
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+
+	vs_out.FragPos = vec3(view * modelMatrix * vec4(aPos, 1.0));
     vs_out.TexCoords = aTexCoords;
     
     // NORMAL MAPPING
-    vs_out.Normal = mat3(transpose(inverse(view * model))) * aNormal;  
-    vec3 T = normalize(vs_out.Normal * vec3(view * model * vec4(aTangent, 1.0)));
+    vs_out.Normal = mat3(transpose(inverse(view * modelMatrix))) * aNormal;  
+    vec3 T = normalize(vs_out.Normal * vec3(view * modelMatrix * vec4(aTangent, 1.0)));
     vec3 N = normalize(vs_out.Normal * aNormal);
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
@@ -42,7 +43,7 @@ void main()
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
     
     // FOG
-    vec4 worldPosition = model * vec4(aPos, 1.0);
+    vec4 worldPosition = modelMatrix * vec4(aPos, 1.0);
     float distance = length(worldPosition.xyz - cameraPos);
     float density = 0.05;
     vs_out.fogFactor = clamp(exp(-pow(density * distance, 2.0)), 0.0, 1.0);
@@ -0,0 +1,207 @@
+#include "shadowatlas.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "glstate.h"
+#include "renderstats.h"
+
+const unsigned int SHADOW_TILES_PER_ROW = SHADOW_ATLAS_SIZE / SHADOW_TILE_SIZE;
+static_assert(SHADOW_TILES_PER_ROW * SHADOW_TILES_PER_ROW == MAX_SHADOW_TILES, "the tiles must fill the atlas");
+
+const float SHADOW_NEAR_PLANE = 0.1f;
+// Widens the light frustum past the outer cone, so the filter taps at its rim stay inside the tile
+const float SHADOW_FRUSTUM_MARGIN = glm::radians(2.0f);
+// Depth bias of the caster draws, constant and along the slope
+const float SHADOW_OFFSET_FACTOR = 2.0f;
+const float SHADOW_OFFSET_UNITS = 4.0f;
+
+bool cullShadowCasters(const Frustum& frustum, const EntityStore& scene, const Bvh& bvh, Entity owner,
+	const std::vector<Entity>& previous, std::vector<Entity>& casters)
+{
+	bvh.queryFrustum(frustum, scene.bounds(), casters);
+	casters.erase(std::remove(casters.begin(), casters.end(), owner), casters.end());
+	std::sort(casters.begin(), casters.end());
+
+	// Objects that entered or left change the list, moves inside the frustum do not
+	if (casters != previous)
+		return true;
+	for (Entity entity : scene.transforms.changed())
+	{
+		if (std::binary_search(casters.begin(), casters.end(), entity))
+			return true;
+	}
+	return false;
+}
+
+void ShadowAtlas::create(const MeshPool& pool, BufferAllocator* instanceStorage)
+{
+	this->pool = &pool;
+	this->instanceStorage = instanceStorage;
+
+	glGenTextures(1, &depthTexture);
+	glState.bindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	// Linear filtering of a compared texture averages the four nearest results
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glGenFramebuffers(1, &FBO);
+	glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::SHADOW_ATLAS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Casters are drawn with their matrices as instance attributes
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	frameDataStride = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+	DrawData drawData = DrawData();
+	drawData.model = glm::mat4(1.0f);
+	drawData.instanced = GL_TRUE;
+	glGenBuffers(1, &uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_SHADOW_TILES * frameDataStride + sizeof(DrawData), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, MAX_SHADOW_TILES * frameDataStride, sizeof(DrawData), &drawData);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+unsigned int ShadowAtlas::addLight(Entity owner)
+{
+	if (lightCount == MAX_SHADOW_TILES)
+		return NO_SHADOW_TILE;
+
+	Light& light = lights[lightCount];
+	light.owner = owner;
+	light.VAO = pool->createVertexArray();
+	light.draws.attach(*pool, instanceStorage, light.VAO);
+	light.dirty = true;
+	return lightCount++;
+}
+
+void ShadowAtlas::setLight(unsigned int tile, const glm::vec3& position, const glm::vec3& direction, float outerCutOff, float range)
+{
+	Light& light = lights[tile];
+	glm::vec3 axis = glm::normalize(direction);
+	glm::vec3 up = std::abs(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::mat4 view = glm::lookAt(position, position + axis, up);
+	float fov = std::min(2.0f * std::acos(outerCutOff) + SHADOW_FRUSTUM_MARGIN, glm::radians(170.0f));
+	glm::mat4 projection = glm::perspective(fov, 1.0f, SHADOW_NEAR_PLANE, std::max(range, 2.0f * SHADOW_NEAR_PLANE));
+
+	if (view != light.view || projection != light.projection)
+		light.dirty = true;
+	light.position = position;
+	light.view = view;
+	light.projection = projection;
+}
+
+void ShadowAtlas::invalidate()
+{
+	for (unsigned int i = 0; i < lightCount; i++)
+		lights[i].dirty = true;
+}
+
+void ShadowAtlas::update(const EntityStore& scene, const Bvh& bvh, const StaticBatcher* staticBatches, Shader& depthShader)
+{
+	lastStats = ShadowAtlasStats();
+	lastStats.lights = lightCount;
+
+	GLint viewport[4] = {};
+	bool bound = false;
+	for (unsigned int tile = 0; tile < lightCount; tile++)
+	{
+		Light& light = lights[tile];
+		bool changed = cullShadowCasters(Frustum::FromMatrix(light.projection * light.view), scene, bvh, light.owner, light.casters, culled);
+		if (!light.dirty && !changed)
+		{
+			lastStats.cached++;
+			continue;
+		}
+
+		if (!bound)
+		{
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glState.bindFramebuffer(GL_FRAMEBUFFER, FBO);
+			glState.setEnabled(GL_DEPTH_TEST, true);
+			glState.setEnabled(GL_BLEND, false);
+			glState.setEnabled(GL_CULL_FACE, false);
+			glState.setEnabled(GL_SCISSOR_TEST, true);
+			glState.setEnabled(GL_POLYGON_OFFSET_FILL, true);
+			glState.depthMask(true);
+			glState.depthFunc(GL_LESS);
+			glPolygonOffset(SHADOW_OFFSET_FACTOR, SHADOW_OFFSET_UNITS);
+			glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, uniformBuffer, MAX_SHADOW_TILES * frameDataStride, sizeof(DrawData));
+			depthShader.use();
+			bound = true;
+		}
+		light.casters.swap(culled);
+		render(tile, scene, staticBatches);
+		light.dirty = false;
+		lastStats.rendered++;
+		lastStats.casters += (unsigned int)light.casters.size();
+	}
+
+	if (bound)
+	{
+		glState.setEnabled(GL_SCISSOR_TEST, false);
+		glState.setEnabled(GL_POLYGON_OFFSET_FILL, false);
+		glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+}
+
+void ShadowAtlas::render(unsigned int tile, const EntityStore& scene, const StaticBatcher* staticBatches)
+{
+	Light& light = lights[tile];
+	light.draws.build(light.casters, scene, light.position, staticBatches);
+
+	FrameData frameData = FrameData();
+	frameData.view = light.view;
+	frameData.projection = light.projection;
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, tile * frameDataStride, sizeof(FrameData), &frameData);
+	renderStats.countBufferUpload(sizeof(FrameData));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, uniformBuffer, tile * frameDataStride, sizeof(FrameData));
+
+	GLint x = (tile % SHADOW_TILES_PER_ROW) * SHADOW_TILE_SIZE, y = (tile / SHADOW_TILES_PER_ROW) * SHADOW_TILE_SIZE;
+	glViewport(x, y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+	glScissor(x, y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glState.bindVertexArray(light.VAO);
+	light.draws.draw(0, light.draws.commandCount());
+}
+
+ShadowData ShadowAtlas::data(const glm::mat4& view) const
+{
+	ShadowData shadowData = ShadowData();
+	shadowData.count = lightCount;
+	shadowData.texelSize = 1.0f / SHADOW_ATLAS_SIZE;
+	glm::mat4 inverseView = glm::inverse(view);
+	float tileScale = 1.0f / SHADOW_TILES_PER_ROW;
+	for (unsigned int tile = 0; tile < lightCount; tile++)
+	{
+		// Clip space of the light to the tile, depth to [0, 1]
+		glm::vec3 corner = glm::vec3((float)(tile % SHADOW_TILES_PER_ROW), (float)(tile / SHADOW_TILES_PER_ROW), 0.0f) * tileScale;
+		glm::mat4 toTile = glm::translate(glm::mat4(1.0f), corner + glm::vec3(0.5f * tileScale, 0.5f * tileScale, 0.5f));
+		toTile = glm::scale(toTile, glm::vec3(0.5f * tileScale, 0.5f * tileScale, 0.5f));
+		shadowData.matrices[tile] = toTile * lights[tile].projection * lights[tile].view * inverseView;
+	}
+	return shadowData;
+}
+
+void ShadowAtlas::bindTexture() const
+{
+	glState.bindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+}
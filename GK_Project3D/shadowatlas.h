@@ -0,0 +1,98 @@
+#ifndef SHADOWATLAS_H
+#define SHADOWATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "bufferallocator.h"
+#include "bvh.h"
+#include "entities.h"
+#include "framedata.h"
+#include "indirect.h"
+#include "meshpool.h"
+#include "shader.h"
+#include "staticbatch.h"
+
+// Square depth texture cut into MAX_SHADOW_TILES square tiles, 4 x 4
+const unsigned int SHADOW_ATLAS_SIZE = 4096;
+const unsigned int SHADOW_TILE_SIZE = 1024;
+// The atlas is sampled from this unit, between the G-buffer and the cluster textures
+const unsigned int SHADOW_TEXTURE_UNIT = 7;
+const unsigned int NO_SHADOW_TILE = 0xFFFFFFFF;
+
+struct ShadowAtlasStats
+{
+	unsigned int lights = 0;
+	unsigned int rendered = 0;      // tiles drawn by the last update()
+	unsigned int cached = 0;        // tiles the last update() kept
+	unsigned int casters = 0;       // objects drawn into the rendered tiles
+};
+
+// Culls the shadow casters inside frustum, sorted and without owner. Returns whether depth drawn
+// for the previous casters is out of date: an object entered or left, or one of them moved.
+bool cullShadowCasters(const Frustum& frustum, const EntityStore& scene, const Bvh& bvh, Entity owner,
+	const std::vector<Entity>& previous, std::vector<Entity>& casters);
+
+// Depth maps of spot lights, one tile of a shared depth texture each, sampled with hardware
+// depth comparison. Every update() culls the casters of each light against its own frustum
+// through the scene hierarchy. A tile is drawn again only when its light moved, an object
+// entered or left the frustum, or one of its casters moved, so lights over a still part of
+// the scene cost a BVH query per frame and no draws.
+// Each light draws its casters through an indirect draw list of its own, on a VAO of its own
+// over the pool buffers.
+class ShadowAtlas
+{
+public:
+	ShadowAtlas() {}
+	ShadowAtlas(const ShadowAtlas&) = delete;
+	ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+	void create(const MeshPool& pool, BufferAllocator* instanceStorage);
+
+	// Gives the light the next tile, NO_SHADOW_TILE when the atlas is full. The owner entity (a
+	// lamp the light is attached to) never casts into the light's tile.
+	unsigned int addLight(Entity owner = NO_ENTITY);
+	// World space pose of the light, set every frame. An unchanged pose keeps the cached tile.
+	void setLight(unsigned int tile, const glm::vec3& position, const glm::vec3& direction, float outerCutOff, float range);
+	// Draws the tiles that are out of date with the depth shader. Changes the framebuffer,
+	// viewport and the FrameData and DrawData bindings, which the caller sets again.
+	void update(const EntityStore& scene, const Bvh& bvh, const StaticBatcher* staticBatches, Shader& depthShader);
+	// Draws every tile again on the next update()
+	void invalidate();
+
+	// Shadow matrices for lights in the view space of the camera
+	ShadowData data(const glm::mat4& view) const;
+	void bindTexture() const;
+	const ShadowAtlasStats& stats() const { return lastStats; }
+
+private:
+	struct Light
+	{
+		Entity owner = NO_ENTITY;
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 projection = glm::mat4(1.0f);
+		std::vector<Entity> casters;        // sorted, as of the last time the tile was drawn
+		IndirectDrawList draws;
+		unsigned int VAO = 0;
+		bool dirty = true;
+	};
+
+	void render(unsigned int tile, const EntityStore& scene, const StaticBatcher* staticBatches);
+
+	const MeshPool* pool = nullptr;
+	BufferAllocator* instanceStorage = nullptr;
+	Light lights[MAX_SHADOW_TILES];
+	unsigned int lightCount = 0;
+	std::vector<Entity> culled;
+
+	unsigned int FBO = 0;
+	unsigned int depthTexture = 0;
+	unsigned int uniformBuffer = 0;     // FrameData of each tile, then the DrawData all tiles share
+	size_t frameDataStride = 0;
+	ShadowAtlasStats lastStats;
+};
+
+#endif
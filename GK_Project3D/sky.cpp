@@ -0,0 +1,74 @@
+#include "sky.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "glstate.h"
+#include "profiler.h"
+#include "renderstats.h"
+#include "stb_image.h"
+
+std::vector<CubemapFace> decodeCubemap(const std::vector<std::string>& paths)
+{
+	std::vector<CubemapFace> faces(paths.size());
+	for (unsigned int i = 0; i < paths.size(); i++)
+	{
+		PROFILE_SCOPE_DETAIL("decodeCubemap", paths[i].c_str());
+		CubemapFace& face = faces[i];
+		unsigned char* data = stbi_load(paths[i].c_str(), &face.width, &face.height, &face.channels, 0);
+		if (data)
+			face.pixels.assign(data, data + (size_t)face.width * face.height * face.channels);
+		else
+			std::cout << "Cubemap texture failed to load at path: " << paths[i] << std::endl;
+		stbi_image_free(data);
+	}
+	return faces;
+}
+
+unsigned int uploadCubemap(const std::vector<CubemapFace>& faces)
+{
+	PROFILE_FUNCTION();
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+	glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		const CubemapFace& face = faces[i];
+		if (face.pixels.empty())
+			continue;
+		GLenum format = face.channels == 4 ? GL_RGBA : GL_RGB;
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, face.width, face.height, 0, format, GL_UNSIGNED_BYTE, face.pixels.data());
+		renderStats.countTextureUpload(face.pixels.size());
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	return textureID;
+}
+
+unsigned int loadCubemap(const std::vector<std::string>& paths)
+{
+	return uploadCubemap(decodeCubemap(paths));
+}
+
+void SkyCycle::create(const std::vector<std::string>& dayFaces, const std::vector<std::string>& nightFaces)
+{
+	dayCubemap = loadCubemap(dayFaces);
+	pendingNight = std::async(std::launch::async, decodeCubemap, nightFaces);
+}
+
+void SkyCycle::update(float deltaTime)
+{
+	if (pendingNight.valid() && pendingNight.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		nightCubemap = uploadCubemap(pendingNight.get());
+
+	// Holds at day until there is a night sky to fade to
+	float target = night && nightCubemap != 0 ? 1.0f : 0.0f;
+	float step = transitionSeconds > 0.0f ? deltaTime / transitionSeconds : 1.0f;
+	blend = blend < target ? std::min(blend + step, target) : std::max(blend - step, target);
+}
@@ -0,0 +1,61 @@
+#ifndef SKY_H
+#define SKY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <future>
+#include <string>
+#include <vector>
+
+struct CubemapFace
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> pixels;      // empty when the file failed to load
+};
+
+// Decodes the faces, in the order +X, -X, +Y, -Y, +Z, -Z. Makes no GL calls, so it can run on
+// any thread.
+std::vector<CubemapFace> decodeCubemap(const std::vector<std::string>& paths);
+// Creates the cube map texture from decoded faces
+unsigned int uploadCubemap(const std::vector<CubemapFace>& faces);
+unsigned int loadCubemap(const std::vector<std::string>& paths);
+
+// Day and night sky, both cube maps resident once loaded. Switching between them starts a
+// crossfade that the sky shader draws as a mix of the two, and the ambient light of the sun
+// follows it, so a switch reads no files and creates no textures.
+// The day sky is loaded by create(). The night sky is decoded on a worker thread and uploaded by
+// the first update() after it is done; a switch to night made before that starts once it is.
+class SkyCycle
+{
+public:
+	SkyCycle() {}
+	SkyCycle(const SkyCycle&) = delete;
+	SkyCycle& operator=(const SkyCycle&) = delete;
+
+	void create(const std::vector<std::string>& dayFaces, const std::vector<std::string>& nightFaces);
+	void setNight(bool night) { this->night = night; }
+	void setTransitionSeconds(float seconds) { transitionSeconds = seconds; }
+	// Uploads the night sky once decoded and moves the crossfade on
+	void update(float deltaTime);
+
+	unsigned int getDayCubemap() const { return dayCubemap; }
+	unsigned int getNightCubemap() const { return nightCubemap; }
+	// 0 is day, 1 is night
+	float getBlend() const { return blend; }
+	glm::vec3 getAmbient() const { return glm::mix(dayAmbient, nightAmbient, blend); }
+
+private:
+	unsigned int dayCubemap = 0;
+	unsigned int nightCubemap = 0;
+	std::future<std::vector<CubemapFace>> pendingNight;
+	bool night = false;
+	float blend = 0.0f;
+	float transitionSeconds = 1.5f;
+	glm::vec3 dayAmbient = glm::vec3(0.5f);
+	glm::vec3 nightAmbient = glm::vec3(0.1f);
+};
+
+#endif
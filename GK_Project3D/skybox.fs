@@ -4,8 +4,14 @@ out vec4 FragColor;
 in vec3 TexCoords;
 
 uniform samplerCube skybox;
+uniform samplerCube skyboxBlend;
+// Crossfade from skybox (0) to skyboxBlend (1)
+uniform float blend;
 
 void main()
 {    
-    FragColor = texture(skybox, TexCoords);
+    vec4 color = texture(skybox, TexCoords);
+    if (blend > 0.0)
+        color = mix(color, texture(skyboxBlend, TexCoords), blend);
+    FragColor = color;
 }
\ No newline at end of file
@@ -1,14 +1,18 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "framedata.glsl"
 
+// Triangle covering the screen at the far plane, so the sky only shades the pixels the scene
+// left empty and depth testing rejects the rest before the fragment shader runs. The view ray of
+// each corner comes from the inverse projection turned back by the camera rotation, the
+// translation of the view is left out so the sky stays at infinity. The rays are not normalized,
+// they stay linear across the screen and interpolate exactly.
 void main()
 {
-    TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
-}  
\ No newline at end of file
+    vec2 corner = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    vec4 viewRay = inverse(projection) * vec4(corner, 1.0, 1.0);
+    TexCoords = transpose(mat3(view)) * (viewRay.xyz / viewRay.w);
+    gl_Position = vec4(corner, 1.0, 1.0);
+}
@@ -0,0 +1,24 @@
+// Spot light shadows from the atlas, see shadowatlas.h. The including shader declares the
+// ShadowData block first (framedata.glsl).
+
+uniform sampler2DShadow shadowAtlas;
+
+// Part of the light of a shadowed spot light that reaches fragPos, from a 3x3 grid of compared taps.
+// The lookup moves a little along the surface normal against shadow acne.
+float SpotShadow(int tile, vec3 fragPos, vec3 normal)
+{
+    if (uint(tile) >= shadowCount)
+        return 1.0;
+    vec4 coords = shadowMatrices[tile] * vec4(fragPos + normal * 0.02, 1.0);
+    if (coords.w <= 0.0)
+        return 1.0;
+    coords.xyz /= coords.w;
+    if (coords.z >= 1.0)
+        return 1.0;
+
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            lit += texture(shadowAtlas, vec3(coords.xy + vec2(x, y) * shadowTexelSize, coords.z));
+    return lit / 9.0;
+}
@@ -0,0 +1,112 @@
+#include "staticbatch.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Float index of the attribute at location inside a vertex, -1 when the layout has none
+static int attributeFloat(const VertexLayout& layout, unsigned int location)
+{
+	for (unsigned int i = 0; i < layout.attributeCount; i++)
+	{
+		if (layout.attributes[i].location == location)
+			return (int)(layout.attributes[i].offset / sizeof(float));
+	}
+	return -1;
+}
+
+void StaticBatcher::add(EntityStore& scene, Entity entity)
+{
+	if (scene.staticBatch[entity] != NO_STATIC_BATCH)
+		return;
+
+	glm::ivec3 cell = glm::ivec3(glm::floor(scene.worldCenter(entity) / STATIC_BATCH_CELL_SIZE));
+	unsigned int batch = 0;
+	while (batch < batches.size() && (batches[batch].material != scene.material[entity] || batches[batch].cell != cell))
+		batch++;
+	if (batch == batches.size())
+	{
+		batches.push_back(StaticBatch());
+		batches.back().material = scene.material[entity];
+		batches.back().cell = cell;
+	}
+
+	batches[batch].members.push_back(entity);
+	batches[batch].dirty = true;
+	scene.staticBatch[entity] = batch;
+}
+
+void StaticBatcher::remove(EntityStore& scene, Entity entity)
+{
+	unsigned int batch = scene.staticBatch[entity];
+	if (batch == NO_STATIC_BATCH)
+		return;
+
+	std::vector<Entity>& members = batches[batch].members;
+	members.erase(std::find(members.begin(), members.end(), entity));
+	batches[batch].dirty = true;
+	scene.staticBatch[entity] = NO_STATIC_BATCH;
+}
+
+void StaticBatcher::build(const EntityStore& scene, const std::vector<MeshData>& sources, MeshPool& pool)
+{
+	const VertexLayout& layout = pool.layout();
+	const unsigned int floatStride = layout.stride / sizeof(float);
+	const int position = attributeFloat(layout, 0);
+	const int normal = attributeFloat(layout, 1);
+	const int tangent = attributeFloat(layout, 3);
+	const int bitangent = attributeFloat(layout, 4);
+
+	for (StaticBatch& batch : batches)
+	{
+		if (!batch.dirty)
+			continue;
+		batch.dirty = false;
+		if (batch.mesh != NO_POOL_MESH)
+			pool.remove(batch.mesh);
+		batch.mesh = NO_POOL_MESH;
+		if (batch.members.empty())
+			continue;
+
+		// Members in the pool layout, moved to world space one after another
+		MeshData merged;
+		merged.layout = layout;
+		for (Entity entity : batch.members)
+		{
+			MeshData member = convertLayout(sources[scene.mesh[entity]], layout);
+			const glm::mat4& world = scene.transforms.world(entity);
+			const glm::mat3 rotation = glm::mat3(world);
+			const glm::mat3& normalMatrix = scene.transforms.normal(entity);
+			const unsigned int baseVertex = merged.vertexCount();
+
+			for (size_t v = 0; v < member.vertices.size(); v += floatStride)
+			{
+				float* vertex = &member.vertices[v];
+				glm::vec3 p = world * glm::vec4(vertex[position], vertex[position + 1], vertex[position + 2], 1.0f);
+				memcpy(vertex + position, &p[0], sizeof(glm::vec3));
+				if (normal >= 0)
+				{
+					glm::vec3 n = normalMatrix * glm::vec3(vertex[normal], vertex[normal + 1], vertex[normal + 2]);
+					memcpy(vertex + normal, &n[0], sizeof(glm::vec3));
+				}
+				if (tangent >= 0)
+				{
+					glm::vec3 t = rotation * glm::vec3(vertex[tangent], vertex[tangent + 1], vertex[tangent + 2]);
+					memcpy(vertex + tangent, &t[0], sizeof(glm::vec3));
+				}
+				if (bitangent >= 0)
+				{
+					glm::vec3 b = rotation * glm::vec3(vertex[bitangent], vertex[bitangent + 1], vertex[bitangent + 2]);
+					memcpy(vertex + bitangent, &b[0], sizeof(glm::vec3));
+				}
+			}
+
+			merged.vertices.insert(merged.vertices.end(), member.vertices.begin(), member.vertices.end());
+			for (unsigned int index : member.indices)
+				merged.indices.push_back(baseVertex + index);
+		}
+		merged.computeBounds();
+
+		batch.mesh = pool.add(merged);
+		rebuildCount++;
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "entities.h"
+#include "mesh.h"
+#include "meshpool.h"
+
+// Edge of the world grid cells static batches are split by
+const float STATIC_BATCH_CELL_SIZE = 8.0f;
+
+struct StaticBatch
+{
+	MaterialHandle material = NO_MATERIAL;
+	glm::ivec3 cell = glm::ivec3(0);    // grid cell of the members' centers
+	MeshHandle mesh = NO_POOL_MESH;     // merged world space geometry, NO_POOL_MESH until built
+	std::vector<Entity> members;
+	bool dirty = false;
+};
+
+// Immobile entities baked into one world space mesh per material and grid cell, drawn with an
+// identity matrix. The members stay in the scene, so culling and occlusion still test them one by
+// one and a draw list draws the whole batch once when any member is visible. The cells keep that
+// from drawing objects far from the visible one, at the cost of more batches. A batch is rebuilt
+// only when its members change, moving a member does not update it.
+class StaticBatcher
+{
+public:
+	// Takes effect at the next build(). The cell comes from the entity's world center, which
+	// must be up to date.
+	void add(EntityStore& scene, Entity entity);
+	void remove(EntityStore& scene, Entity entity);
+	// Re-bakes the batches whose members changed. sources[mesh] is the CPU copy of every mesh
+	// the members use, their world matrices must be up to date.
+	void build(const EntityStore& scene, const std::vector<MeshData>& sources, MeshPool& pool);
+
+	unsigned int count() const { return (unsigned int)batches.size(); }
+	const StaticBatch& get(unsigned int batch) const { return batches[batch]; }
+	unsigned int rebuilds() const { return rebuildCount; }
+
+private:
+	std::vector<StaticBatch> batches;
+	unsigned int rebuildCount = 0;
+};
+
+#endif
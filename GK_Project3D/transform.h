@@ -0,0 +1,129 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <vector>
+
+typedef unsigned int TransformHandle;
+const TransformHandle NO_TRANSFORM = 0xFFFFFFFF;
+
+// Parent/child transforms with cached world and normal matrices.
+// A parent is always created before its children, so one pass in handle order updates
+// the hierarchy top-down. Only transforms set since the last update() and their
+// descendants are recomputed, everything else keeps its cached matrices.
+class TransformSystem
+{
+public:
+	TransformHandle create(TransformHandle parent = NO_TRANSFORM,
+		const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f))
+	{
+		TransformHandle handle = (TransformHandle)parents.size();
+		parents.push_back(parent);
+		positions.push_back(position);
+		rotations.push_back(rotation);
+		scales.push_back(scale);
+		worldMatrices.push_back(glm::mat4(1.0f));
+		normalMatrices.push_back(glm::mat3(1.0f));
+		dirty.push_back(0);
+		updateStamps.push_back(0);
+		markDirty(handle);
+		return handle;
+	}
+
+	unsigned int count() const { return (unsigned int)parents.size(); }
+
+	void setPosition(TransformHandle handle, const glm::vec3& position)
+	{
+		positions[handle] = position;
+		markDirty(handle);
+	}
+	void setRotation(TransformHandle handle, const glm::quat& rotation)
+	{
+		rotations[handle] = rotation;
+		markDirty(handle);
+	}
+	void setScale(TransformHandle handle, const glm::vec3& scale)
+	{
+		scales[handle] = scale;
+		markDirty(handle);
+	}
+	void setLocal(TransformHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f))
+	{
+		positions[handle] = position;
+		rotations[handle] = rotation;
+		scales[handle] = scale;
+		markDirty(handle);
+	}
+
+	TransformHandle getParent(TransformHandle handle) const { return parents[handle]; }
+	const glm::vec3& getPosition(TransformHandle handle) const { return positions[handle]; }
+	const glm::quat& getRotation(TransformHandle handle) const { return rotations[handle]; }
+	const glm::vec3& getScale(TransformHandle handle) const { return scales[handle]; }
+
+	// Cached matrices, valid after update()
+	const glm::mat4& world(TransformHandle handle) const { return worldMatrices[handle]; }
+	const glm::mat3& normal(TransformHandle handle) const { return normalMatrices[handle]; }
+
+	// Recomputes moved transforms and their descendants, returns how many were recomputed
+	unsigned int update()
+	{
+		updated.clear();
+		stamp++;
+		if (firstDirty == NO_TRANSFORM)
+			return 0;
+
+		for (TransformHandle i = firstDirty; i < count(); i++)
+		{
+			TransformHandle parent = parents[i];
+			bool parentMoved = parent != NO_TRANSFORM && updateStamps[parent] == stamp;
+			if (!dirty[i] && !parentMoved)
+				continue;
+
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]);
+			local = glm::scale(local, scales[i]);
+			worldMatrices[i] = parent != NO_TRANSFORM ? worldMatrices[parent] * local : local;
+			normalMatrices[i] = glm::inverseTranspose(glm::mat3(worldMatrices[i]));
+
+			dirty[i] = 0;
+			updateStamps[i] = stamp;
+			updated.push_back(i);
+		}
+		firstDirty = NO_TRANSFORM;
+		return (unsigned int)updated.size();
+	}
+
+	// Transforms recomputed by the last update(), in handle order
+	const std::vector<TransformHandle>& changed() const { return updated; }
+	bool changed(TransformHandle handle) const { return updateStamps[handle] == stamp; }
+
+private:
+	void markDirty(TransformHandle handle)
+	{
+		dirty[handle] = 1;
+		firstDirty = firstDirty == NO_TRANSFORM ? handle : std::min(firstDirty, handle);
+	}
+
+	// Local transform
+	std::vector<TransformHandle> parents;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+
+	// Cache
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<glm::mat3> normalMatrices;
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned int> updateStamps;
+	std::vector<TransformHandle> updated;
+	TransformHandle firstDirty = NO_TRANSFORM;
+	unsigned int stamp = 0;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#version 330 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform float sharpness;    // 0 is plain bilinear
+
+// Bilinear upscale of the scene target with an unsharp mask over its four neighbouring texels.
+// The result stays inside the range of the taps, so edges do not ring.
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec3 center = texture(scene, TexCoords).rgb;
+    vec3 left = texture(scene, TexCoords - vec2(texel.x, 0.0)).rgb;
+    vec3 right = texture(scene, TexCoords + vec2(texel.x, 0.0)).rgb;
+    vec3 down = texture(scene, TexCoords - vec2(0.0, texel.y)).rgb;
+    vec3 up = texture(scene, TexCoords + vec2(0.0, texel.y)).rgb;
+
+    vec3 lowest = min(center, min(min(left, right), min(down, up)));
+    vec3 highest = max(center, max(max(left, right), max(down, up)));
+    vec3 sharpened = center + (4.0 * center - left - right - down - up) * sharpness;
+    FragColor = vec4(clamp(sharpened, lowest, highest), 1.0);
+}
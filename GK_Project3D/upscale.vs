@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec2 TexCoords;
+
+// Triangle covering the screen, texture coordinates run 0 to 1 over the visible part
+void main()
+{
+    vec2 corner = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    TexCoords = corner * 0.5 + 0.5;
+    gl_Position = vec4(corner, 0.0, 1.0);
+}